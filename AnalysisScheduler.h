@@ -0,0 +1,392 @@
+#ifndef TOMATL_ANALYSIS_SCHEDULER
+#define TOMATL_ANALYSIS_SCHEDULER
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+namespace tomatl { namespace dsp {
+
+	struct AnalysisLatency
+	{
+		AnalysisLatency() : mLastMs(0.), mAverageMs(0.), mMaxMs(0.), mRunCount(0)
+		{
+		}
+
+		double mLastMs;		// From notify() to the end of drain()
+		double mAverageMs;	// Exponential average over roughly last 100 runs
+		double mMaxMs;		// Since registration or resetLatency()
+		size_t mRunCount;
+	};
+
+	// Shared pool for many analysis tasks (typically one AsyncSpectroCalculator per track).
+	// Audio threads call notify() after enqueueing samples, which is two atomic operations. Dispatcher thread collects
+	// notified tasks, sorts them by group key (FFT size) and hands out whole groups to the least loaded workers, so
+	// consecutive tasks on a core use the same tables. Idle workers steal from the back of other workers' queues,
+	// so a burst at a hop boundary spreads over all cores.
+	class AnalysisScheduler
+	{
+	public:
+		// threadCount of 0 means hardware concurrency minus one (for the audio thread).
+		// Task slots are preallocated, so notify() never races with registration of other tasks.
+		AnalysisScheduler(size_t threadCount = 0, size_t maxTaskCount = 1024, double pollIntervalMs = 1.)
+			: mPollIntervalMs(pollIntervalMs), mRunning(false), mInstances(new Instance[maxTaskCount]), mMaxTaskCount(maxTaskCount), mTaskCount(0)
+		{
+			if (threadCount == 0)
+			{
+				threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+			}
+
+			threadCount = std::max((size_t)1, threadCount);
+
+			for (size_t i = 0; i < threadCount; ++i)
+			{
+				mWorkers.push_back(std::unique_ptr<Worker>(new Worker()));
+			}
+		}
+
+		~AnalysisScheduler()
+		{
+			stop();
+		}
+
+		// Not for audio thread. Returned handle is used for notify() and latency queries, cInvalidHandle if all slots are taken.
+		size_t addTask(IAnalysisTask* task)
+		{
+			std::lock_guard<std::mutex> lock(mInstanceLock);
+
+			size_t handle = mTaskCount;
+
+			if (handle >= mMaxTaskCount)
+			{
+				return cInvalidHandle;
+			}
+
+			mInstances[handle].mTask = task;
+			mInstances[handle].mGroupKey = task->getGroupKey();
+			mTaskCount.store(handle + 1, std::memory_order_release);
+
+			return handle;
+		}
+
+		// Blocks until the task isn't queued or running anywhere, so it can be destroyed right after this returns.
+		// Handle isn't reused.
+		void removeTask(size_t handle)
+		{
+			Instance* instance = getInstance(handle);
+
+			if (instance == NULL)
+			{
+				return;
+			}
+
+			{
+				// Dispatcher checks the flag under the same lock, so after this it can't queue the task anymore
+				std::lock_guard<std::mutex> lock(mInstanceLock);
+				instance->mRemoved = true;
+			}
+
+			while (instance->mQueued)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		// Audio thread: new input has been enqueued into the task. One notifying thread per task.
+		void notify(size_t handle)
+		{
+			TOMATL_RT_SCOPE();
+
+			Instance* instance = &mInstances[handle];
+
+			// Timestamp goes first, so dispatcher never sees the flag with a stale one
+			if (!instance->mPending.load(std::memory_order_acquire))
+			{
+				instance->mPendingSince.store(now(), std::memory_order_relaxed);
+				instance->mPending.store(true, std::memory_order_release);
+			}
+		}
+
+		AnalysisLatency getLatency(size_t handle)
+		{
+			AnalysisLatency result;
+			Instance* instance = getInstance(handle);
+
+			if (instance != NULL)
+			{
+				result.mLastMs = instance->mLastMs;
+				result.mAverageMs = instance->mAverageMs;
+				result.mMaxMs = instance->mMaxMs;
+				result.mRunCount = instance->mRunCount;
+			}
+
+			return result;
+		}
+
+		void resetLatency(size_t handle)
+		{
+			Instance* instance = getInstance(handle);
+
+			if (instance != NULL)
+			{
+				instance->mMaxMs = 0.;
+			}
+		}
+
+		size_t getThreadCount() { return mWorkers.size(); }
+
+		void start()
+		{
+			if (mRunning.exchange(true))
+			{
+				return;
+			}
+
+			for (size_t i = 0; i < mWorkers.size(); ++i)
+			{
+				mWorkers[i]->mThread = std::thread([this, i]() { runWorker(i); });
+			}
+
+			mDispatcher = std::thread([this]() { runDispatcher(); });
+		}
+
+		void stop()
+		{
+			if (!mRunning.exchange(false))
+			{
+				return;
+			}
+
+			mDispatcher.join();
+
+			for (size_t i = 0; i < mWorkers.size(); ++i)
+			{
+				mWorkers[i]->mWakeUp.notify_all();
+				mWorkers[i]->mThread.join();
+			}
+
+			// Whatever workers didn't get to stays pending, so removeTask() doesn't wait for runs which will never happen
+			for (size_t i = 0; i < mWorkers.size(); ++i)
+			{
+				std::lock_guard<std::mutex> lock(mWorkers[i]->mLock);
+
+				for (size_t j = 0; j < mWorkers[i]->mQueue.size(); ++j)
+				{
+					mWorkers[i]->mQueue[j]->mPending = true;
+					mWorkers[i]->mQueue[j]->mQueued = false;
+				}
+
+				mWorkers[i]->mQueue.clear();
+			}
+		}
+
+		static const size_t cInvalidHandle = (size_t)-1;
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(AnalysisScheduler);
+
+		typedef std::chrono::steady_clock Clock;
+
+		struct Instance
+		{
+			Instance() : mTask(NULL), mGroupKey(0), mPending(false), mQueued(false), mRemoved(false), mPendingSince(0), mDispatchedSince(0),
+				mLastMs(0.), mAverageMs(0.), mMaxMs(0.), mRunCount(0)
+			{
+			}
+
+			IAnalysisTask* mTask;
+			size_t mGroupKey;
+			std::atomic<bool> mPending;
+			std::atomic<bool> mQueued;
+			std::atomic<bool> mRemoved;
+			std::atomic<long long> mPendingSince;
+			long long mDispatchedSince;
+
+			// Written by the worker which runs the task, read by anyone
+			std::atomic<double> mLastMs;
+			std::atomic<double> mAverageMs;
+			std::atomic<double> mMaxMs;
+			std::atomic<size_t> mRunCount;
+		};
+
+		struct Worker
+		{
+			std::deque<Instance*> mQueue;
+			std::mutex mLock;
+			std::condition_variable mWakeUp;
+			std::thread mThread;
+		};
+
+		static long long now()
+		{
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+		}
+
+		Instance* getInstance(size_t handle)
+		{
+			return handle < mTaskCount.load(std::memory_order_acquire) ? &mInstances[handle] : NULL;
+		}
+
+		void runDispatcher()
+		{
+			std::vector<Instance*> batch;
+			std::vector<size_t> load(mWorkers.size());
+
+			while (mRunning)
+			{
+				batch.clear();
+
+				{
+					std::lock_guard<std::mutex> lock(mInstanceLock);
+
+					for (size_t i = 0; i < mTaskCount; ++i)
+					{
+						Instance* instance = &mInstances[i];
+
+						if (!instance->mRemoved && !instance->mQueued && instance->mPending.load(std::memory_order_acquire))
+						{
+							instance->mDispatchedSince = instance->mPendingSince.load(std::memory_order_acquire);
+							instance->mPending.store(false, std::memory_order_release);
+							instance->mQueued = true;
+							batch.push_back(instance);
+						}
+					}
+				}
+
+				if (!batch.empty())
+				{
+					dispatch(batch, load);
+				}
+
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)(mPollIntervalMs * 1000.)));
+			}
+		}
+
+		void dispatch(std::vector<Instance*>& batch, std::vector<size_t>& load)
+		{
+			std::stable_sort(batch.begin(), batch.end(), [](const Instance* a, const Instance* b) { return a->mGroupKey < b->mGroupKey; });
+
+			for (size_t i = 0; i < mWorkers.size(); ++i)
+			{
+				std::lock_guard<std::mutex> lock(mWorkers[i]->mLock);
+				load[i] = mWorkers[i]->mQueue.size();
+			}
+
+			// Whole groups go to the least loaded worker, stealing evens things out if groups are uneven
+			size_t start = 0;
+
+			while (start < batch.size())
+			{
+				size_t end = start;
+
+				while (end < batch.size() && batch[end]->mGroupKey == batch[start]->mGroupKey)
+				{
+					++end;
+				}
+
+				size_t target = std::min_element(load.begin(), load.end()) - load.begin();
+
+				{
+					std::lock_guard<std::mutex> lock(mWorkers[target]->mLock);
+					mWorkers[target]->mQueue.insert(mWorkers[target]->mQueue.end(), batch.begin() + start, batch.begin() + end);
+				}
+
+				load[target] += end - start;
+				start = end;
+			}
+
+			for (size_t i = 0; i < mWorkers.size(); ++i)
+			{
+				mWorkers[i]->mWakeUp.notify_one();
+			}
+		}
+
+		Instance* takeWork(size_t self)
+		{
+			{
+				std::lock_guard<std::mutex> lock(mWorkers[self]->mLock);
+
+				if (!mWorkers[self]->mQueue.empty())
+				{
+					Instance* result = mWorkers[self]->mQueue.front();
+					mWorkers[self]->mQueue.pop_front();
+
+					return result;
+				}
+			}
+
+			// Steal from the back, which is the far end of victim's current group
+			for (size_t offset = 1; offset < mWorkers.size(); ++offset)
+			{
+				Worker& victim = *mWorkers[(self + offset) % mWorkers.size()];
+				std::lock_guard<std::mutex> lock(victim.mLock);
+
+				if (!victim.mQueue.empty())
+				{
+					Instance* result = victim.mQueue.back();
+					victim.mQueue.pop_back();
+
+					return result;
+				}
+			}
+
+			return NULL;
+		}
+
+		void runWorker(size_t self)
+		{
+			while (mRunning)
+			{
+				Instance* instance = takeWork(self);
+
+				if (instance == NULL)
+				{
+					std::unique_lock<std::mutex> lock(mWorkers[self]->mLock);
+
+					if (mWorkers[self]->mQueue.empty() && mRunning)
+					{
+						mWorkers[self]->mWakeUp.wait_for(lock, std::chrono::microseconds((long long)(mPollIntervalMs * 1000.)));
+					}
+
+					continue;
+				}
+
+				if (!instance->mRemoved)
+				{
+					instance->mTask->drain();
+					updateLatency(*instance, (now() - instance->mDispatchedSince) * 1e-6);
+				}
+
+				instance->mQueued = false;
+			}
+		}
+
+		void updateLatency(Instance& instance, double latencyMs)
+		{
+			const double averaging = 0.01;
+
+			instance.mLastMs = latencyMs;
+			instance.mAverageMs = (instance.mRunCount == 0) ? latencyMs : instance.mAverageMs + (latencyMs - instance.mAverageMs) * averaging;
+			instance.mMaxMs = std::max((double)instance.mMaxMs, latencyMs);
+			++instance.mRunCount;
+		}
+
+		double mPollIntervalMs;
+		std::atomic<bool> mRunning;
+		std::unique_ptr<Instance[]> mInstances;
+		size_t mMaxTaskCount;
+		std::atomic<size_t> mTaskCount;
+		std::mutex mInstanceLock;
+		std::vector<std::unique_ptr<Worker>> mWorkers;
+		std::thread mDispatcher;
+	};
+
+}}
+
+#endif
@@ -0,0 +1,288 @@
+#ifndef TOMATL_ASYNC_SPECTRO_CALCULATOR
+#define TOMATL_ASYNC_SPECTRO_CALCULATOR
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+namespace tomatl { namespace dsp {
+
+	// Anything SpectroWorker can run. drain() is called from the worker thread only and returns amount of work done,
+	// zero meaning there was nothing to do.
+	class IAnalysisTask
+	{
+	public:
+		virtual size_t drain() = 0;
+
+		// Tasks with the same key share tables and scratch sizes (e.g. FFT size), schedulers may run them back to back
+		virtual size_t getGroupKey() { return 0; }
+
+		virtual ~IAnalysisTask() {}
+	};
+
+	// SpectroCalculator split across threads: audio thread only copies samples into a lock-free ring (cost doesn't depend
+	// on FFT size and nothing is allocated), analysis happens in drain() on a worker thread, and completed frames
+	// are handed to the UI through triple_buffer.
+	//
+	// Calculator settings (smoothing, derived outputs, phase, multitaper) should be changed through getCalculator()
+	// from the thread which calls drain(), or before the worker is started.
+	template <typename T> class AsyncSpectroCalculator : public IAnalysisTask
+	{
+	public:
+		// Ring holds ringLengthMs of audio, anything beyond that is dropped (and counted) if worker falls behind
+		AsyncSpectroCalculator(double sampleRate, std::pair<double, double> attackRelease, size_t index, size_t fftSize = 1024,
+			size_t channelCount = 2, double ringLengthMs = 500.)
+			: mCalculator(sampleRate, attackRelease, index, fftSize, channelCount), mFftSize(fftSize), mChannelCount(channelCount), mIndex(index),
+			mRing((size_t)(sampleRate * ringLengthMs * 0.001) * channelCount), mSampleRate(sampleRate), mDroppedSamples(0),
+			mExchange(PublishedFrame(fftSize / 2))
+		{
+			mDrainBuffer.resize(cChunkLength * channelCount);
+
+			// At least one whole frame has to fit, even for channel counts above cChunkLength
+			mChunk.resize(std::max(cChunkLength, channelCount));
+		}
+
+		// Audio thread. channels[c][i] layout, as hosts pass it.
+		void enqueue(const T* const* channels, size_t sampleCount, double sampleRate)
+		{
+			TOMATL_RT_SCOPE();
+
+			mSampleRate.store(sampleRate, std::memory_order_relaxed);
+
+			T* chunk = &mChunk[0];
+			const size_t channelCount = mChannelCount;
+			const size_t chunkFrames = mChunk.size() / channelCount;
+
+			for (size_t start = 0; start < sampleCount; start += chunkFrames)
+			{
+				size_t length = std::min(chunkFrames, sampleCount - start);
+
+				for (size_t i = 0; i < length; ++i)
+				{
+					for (size_t c = 0; c < channelCount; ++c)
+					{
+						chunk[i * channelCount + c] = channels[c][start + i];
+					}
+				}
+
+				// Whole multichannel frames only, so reader never gets out of channel sync
+				size_t fitting = std::min(length, mRing.free_space() / channelCount);
+				mRing.write(chunk, fitting * channelCount);
+
+				if (fitting < length)
+				{
+					mDroppedSamples.fetch_add(length - fitting, std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Worker thread. Runs the analysis for everything enqueued so far, returns number of frames published.
+		virtual size_t drain()
+		{
+			size_t published = 0;
+
+			mCalculator.checkSampleRate(mSampleRate.load(std::memory_order_relaxed));
+
+			while (true)
+			{
+				size_t count = mRing.read(&mDrainBuffer[0], mDrainBuffer.size()) / mChannelCount;
+
+				if (count == 0)
+				{
+					break;
+				}
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					SpectrumBlock block = mCalculator.process(&mDrainBuffer[i * mChannelCount]);
+
+					if (block.mData != NULL)
+					{
+						publish(block);
+						++published;
+					}
+				}
+			}
+
+			return published;
+		}
+
+		// UI thread. Latest published frame, its data stays valid until the next call. Empty block until first frame is ready.
+		SpectrumBlock acquireFrame()
+		{
+			mExchange.update();
+
+			PublishedFrame& frame = mExchange.front();
+
+			if (frame.mBlock.mLength == 0)
+			{
+				return SpectrumBlock();
+			}
+
+			SpectrumBlock result = frame.mBlock;
+			result.mData = &frame.mData[0];
+
+			return result;
+		}
+
+		virtual size_t getGroupKey() { return mFftSize; }
+
+		size_t getDroppedSampleCount() { return mDroppedSamples.load(std::memory_order_relaxed); }
+
+		SpectroCalculator<T>& getCalculator() { return mCalculator; }
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(AsyncSpectroCalculator);
+
+		// Interleaving scratch length, in samples
+		static constexpr size_t cChunkLength = 512;
+
+		struct PublishedFrame
+		{
+			PublishedFrame(size_t length = 0) : mData(length)
+			{
+			}
+
+			std::vector<std::pair<double, double>> mData;
+			SpectrumBlock mBlock; // Metadata only, mData of it points to the calculator's buffer
+		};
+
+		void publish(const SpectrumBlock& block)
+		{
+			PublishedFrame& frame = mExchange.back();
+
+			// Size only changes if calculator was reconfigured, normally this is a plain copy
+			frame.mData.assign(block.mData, block.mData + block.mLength);
+			frame.mBlock = block;
+
+			mExchange.publish();
+		}
+
+		SpectroCalculator<T> mCalculator;
+		size_t mFftSize;
+		size_t mChannelCount;
+		size_t mIndex;
+		spsc_ring<T> mRing;
+		std::vector<T> mChunk;
+		std::vector<T> mDrainBuffer;
+		std::atomic<double> mSampleRate;
+		std::atomic<size_t> mDroppedSamples;
+		triple_buffer<PublishedFrame> mExchange;
+	};
+
+	template <typename T> constexpr size_t AsyncSpectroCalculator<T>::cChunkLength;
+
+	// Background thread which keeps draining registered tasks. Sleeps for pollIntervalMs when none of them had work.
+	class SpectroWorker
+	{
+	public:
+		SpectroWorker(double pollIntervalMs = 2.) : mPollIntervalMs(pollIntervalMs), mRunning(false), mWorkerAlive(false), mPassCount(0)
+		{
+		}
+
+		~SpectroWorker()
+		{
+			stop();
+		}
+
+		// Not for audio thread, takes a lock
+		void addTask(IAnalysisTask* task)
+		{
+			std::lock_guard<std::mutex> lock(mTaskLock);
+			mTasks.push_back(task);
+		}
+
+		// Blocks until the drain pass in progress (if any) is over, so task can be destroyed right after this returns.
+		// Not to be called from drain().
+		void removeTask(IAnalysisTask* task)
+		{
+			std::unique_lock<std::mutex> lock(mTaskLock);
+			mTasks.erase(std::remove(mTasks.begin(), mTasks.end(), task), mTasks.end());
+
+			// Passes starting after this point don't see the task, the one which may still be running ends with the counter
+			const size_t pass = mPassCount;
+			mWakeUp.notify_all();
+			mPassDone.wait(lock, [this, pass]() { return mPassCount != pass || !mWorkerAlive; });
+		}
+
+		void start()
+		{
+			if (!mRunning.exchange(true))
+			{
+				{
+					std::lock_guard<std::mutex> lock(mTaskLock);
+					mWorkerAlive = true;
+				}
+
+				mThread = std::thread([this]() { run(); });
+			}
+		}
+
+		void stop()
+		{
+			if (mRunning.exchange(false))
+			{
+				mWakeUp.notify_all();
+				mThread.join();
+			}
+		}
+
+		bool isRunning() { return mRunning; }
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(SpectroWorker);
+
+		// Task list is copied under the lock and drained without it, so addTask() and removeTask() never wait
+		// for more than one pass, however busy the tasks are
+		void run()
+		{
+			while (mRunning)
+			{
+				{
+					std::lock_guard<std::mutex> lock(mTaskLock);
+					mPassTasks.assign(mTasks.begin(), mTasks.end());
+				}
+
+				size_t work = 0;
+
+				for (size_t i = 0; i < mPassTasks.size(); ++i)
+				{
+					work += mPassTasks[i]->drain();
+				}
+
+				std::unique_lock<std::mutex> lock(mTaskLock);
+
+				++mPassCount;
+				mPassDone.notify_all();
+
+				if (work == 0 && mRunning)
+				{
+					mWakeUp.wait_for(lock, std::chrono::microseconds((long long)(mPollIntervalMs * 1000.)));
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mTaskLock);
+			mWorkerAlive = false;
+			mPassDone.notify_all();
+		}
+
+		double mPollIntervalMs;
+		std::atomic<bool> mRunning;
+		// Guarded by mTaskLock
+		bool mWorkerAlive;
+		size_t mPassCount;
+		std::vector<IAnalysisTask*> mTasks;
+		std::vector<IAnalysisTask*> mPassTasks;	// Worker thread only
+		std::mutex mTaskLock;
+		std::condition_variable mWakeUp;
+		std::condition_variable mPassDone;
+		std::thread mThread;
+	};
+
+}}
+
+#endif
@@ -0,0 +1,433 @@
+#ifndef TOMATL_BIQUAD
+#define TOMATL_BIQUAD
+
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+
+namespace tomatl { namespace dsp {
+
+	// Normalized (a0 = 1) second order section
+	struct BiQuadCoefficients
+	{
+		BiQuadCoefficients() : mB0(1.), mB1(0.), mB2(0.), mA1(0.), mA2(0.)
+		{
+		}
+
+		BiQuadCoefficients(double b0, double b1, double b2, double a0, double a1, double a2)
+		{
+			mB0 = b0 / a0;
+			mB1 = b1 / a0;
+			mB2 = b2 / a0;
+			mA1 = a1 / a0;
+			mA2 = a2 / a0;
+		}
+
+		// RBJ audio EQ cookbook designs. Gain is only used by peak and shelves.
+		static BiQuadCoefficients lowPass(double frequency, double q, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+
+			return BiQuadCoefficients((1. - v.mCos) / 2., 1. - v.mCos, (1. - v.mCos) / 2., 1. + v.mAlpha, -2. * v.mCos, 1. - v.mAlpha);
+		}
+
+		static BiQuadCoefficients highPass(double frequency, double q, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+
+			return BiQuadCoefficients((1. + v.mCos) / 2., -(1. + v.mCos), (1. + v.mCos) / 2., 1. + v.mAlpha, -2. * v.mCos, 1. - v.mAlpha);
+		}
+
+		// Constant 0 dB peak gain
+		static BiQuadCoefficients bandPass(double frequency, double q, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+
+			return BiQuadCoefficients(v.mAlpha, 0., -v.mAlpha, 1. + v.mAlpha, -2. * v.mCos, 1. - v.mAlpha);
+		}
+
+		static BiQuadCoefficients notch(double frequency, double q, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+
+			return BiQuadCoefficients(1., -2. * v.mCos, 1., 1. + v.mAlpha, -2. * v.mCos, 1. - v.mAlpha);
+		}
+
+		static BiQuadCoefficients allPass(double frequency, double q, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+
+			return BiQuadCoefficients(1. - v.mAlpha, -2. * v.mCos, 1. + v.mAlpha, 1. + v.mAlpha, -2. * v.mCos, 1. - v.mAlpha);
+		}
+
+		static BiQuadCoefficients peak(double frequency, double q, double gainDb, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+			double a = std::pow(10., gainDb / 40.);
+
+			return BiQuadCoefficients(1. + v.mAlpha * a, -2. * v.mCos, 1. - v.mAlpha * a, 1. + v.mAlpha / a, -2. * v.mCos, 1. - v.mAlpha / a);
+		}
+
+		static BiQuadCoefficients lowShelf(double frequency, double q, double gainDb, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+			double a = std::pow(10., gainDb / 40.);
+			double s = 2. * std::sqrt(a) * v.mAlpha;
+
+			return BiQuadCoefficients(
+				a * ((a + 1.) - (a - 1.) * v.mCos + s),
+				2. * a * ((a - 1.) - (a + 1.) * v.mCos),
+				a * ((a + 1.) - (a - 1.) * v.mCos - s),
+				(a + 1.) + (a - 1.) * v.mCos + s,
+				-2. * ((a - 1.) + (a + 1.) * v.mCos),
+				(a + 1.) + (a - 1.) * v.mCos - s);
+		}
+
+		static BiQuadCoefficients highShelf(double frequency, double q, double gainDb, double sampleRate)
+		{
+			Intermediate v(frequency, q, sampleRate);
+			double a = std::pow(10., gainDb / 40.);
+			double s = 2. * std::sqrt(a) * v.mAlpha;
+
+			return BiQuadCoefficients(
+				a * ((a + 1.) + (a - 1.) * v.mCos + s),
+				-2. * a * ((a - 1.) + (a + 1.) * v.mCos),
+				a * ((a + 1.) + (a - 1.) * v.mCos - s),
+				(a + 1.) - (a - 1.) * v.mCos + s,
+				2. * ((a - 1.) - (a + 1.) * v.mCos),
+				(a + 1.) - (a - 1.) * v.mCos - s);
+		}
+
+		// H(e^jw) at given frequency
+		std::complex<double> getResponse(double frequency, double sampleRate) const
+		{
+			double w = 2. * TOMATL_PI * frequency / sampleRate;
+			std::complex<double> z1 = std::polar(1., -w);
+			std::complex<double> z2 = z1 * z1;
+
+			return (mB0 + mB1 * z1 + mB2 * z2) / (1. + mA1 * z1 + mA2 * z2);
+		}
+
+		double getMagnitudeDb(double frequency, double sampleRate) const
+		{
+			return TOMATL_TO_DB(std::max(std::abs(getResponse(frequency, sampleRate)), 1e-15));
+		}
+
+		double mB0;
+		double mB1;
+		double mB2;
+		double mA1;
+		double mA2;
+
+	private:
+		struct Intermediate
+		{
+			Intermediate(double frequency, double q, double sampleRate)
+			{
+				double w = 2. * TOMATL_PI * std::min(frequency, sampleRate * 0.499) / sampleRate;
+
+				mCos = std::cos(w);
+				mAlpha = std::sin(w) / (2. * std::max(q, 1e-3));
+			}
+
+			double mCos;
+			double mAlpha;
+		};
+	};
+
+	// One EQ band as the user sees it. EqualizerGrid draws these.
+	class FrequencyDomainFilter
+	{
+	public:
+		enum FilterType
+		{
+			filterPeak = 0,
+			filterLowShelf,
+			filterHighShelf,
+			filterLowPass,
+			filterHighPass,
+			filterBandPass,
+			filterNotch,
+			filterAllPass
+		};
+
+		FrequencyDomainFilter(FilterType type = filterPeak, double frequency = 1000., double q = 0.707, double gainDb = 0.)
+			: mType(type), mFrequency(frequency), mQ(q), mGainDb(gainDb), mEnabled(true)
+		{
+		}
+
+		BiQuadCoefficients getCoefficients(double sampleRate) const
+		{
+			switch (mType)
+			{
+			case filterLowShelf: return BiQuadCoefficients::lowShelf(mFrequency, mQ, mGainDb, sampleRate);
+			case filterHighShelf: return BiQuadCoefficients::highShelf(mFrequency, mQ, mGainDb, sampleRate);
+			case filterLowPass: return BiQuadCoefficients::lowPass(mFrequency, mQ, sampleRate);
+			case filterHighPass: return BiQuadCoefficients::highPass(mFrequency, mQ, sampleRate);
+			case filterBandPass: return BiQuadCoefficients::bandPass(mFrequency, mQ, sampleRate);
+			case filterNotch: return BiQuadCoefficients::notch(mFrequency, mQ, sampleRate);
+			case filterAllPass: return BiQuadCoefficients::allPass(mFrequency, mQ, sampleRate);
+			default: return BiQuadCoefficients::peak(mFrequency, mQ, mGainDb, sampleRate);
+			}
+		}
+
+		double getMagnitudeDb(double frequency, double sampleRate) const
+		{
+			return mEnabled ? getCoefficients(sampleRate).getMagnitudeDb(frequency, sampleRate) : 0.;
+		}
+
+		FilterType mType;
+		double mFrequency;
+		double mQ;
+		double mGainDb;
+		bool mEnabled;
+	};
+
+	// Cascades of biquads for many channels (or bands) at once. Channels are grouped by TLanes, and every group keeps
+	// its coefficients and state as structure of arrays, so the per-sample inner loop runs over lanes with identical
+	// operations and compiles to SIMD. Transposed direct form II.
+	//
+	// Coefficient changes are ramped linearly over setRampLength() samples instead of jumping, which removes zipper
+	// noise from automation. Interpolating between two stable sets is stable for practical ramp lengths.
+	template <typename T, size_t TLanes = 4> class BiQuadBank
+	{
+	public:
+		BiQuadBank(size_t channelCount, size_t sectionCount, size_t rampLength = 64)
+			: mChannelCount(channelCount), mSectionCount(sectionCount), mRampLength(std::max((size_t)1, rampLength))
+		{
+			mGroupCount = (channelCount + TLanes - 1) / TLanes;
+			mSections.resize(mGroupCount * sectionCount);
+			mTargets.resize(channelCount * sectionCount);
+			mRampRemaining.assign(mGroupCount, 0);
+		}
+
+		size_t getChannelCount() { return mChannelCount; }
+		size_t getSectionCount() { return mSectionCount; }
+
+		void setRampLength(size_t samples) { mRampLength = std::max((size_t)1, samples); }
+
+		// Ramped change, takes effect over next getRampLength() samples
+		void setCoefficients(size_t channel, size_t section, const BiQuadCoefficients& coefficients)
+		{
+			mTargets[channel * mSectionCount + section] = coefficients;
+
+			size_t group = channel / TLanes;
+
+			// Whole group restarts its ramp from where it is now, lanes which already reached their targets get zero steps
+			for (size_t s = 0; s < mSectionCount; ++s)
+			{
+				Section& sec = getSection(group, s);
+
+				for (size_t lane = 0; lane < TLanes; ++lane)
+				{
+					size_t ch = group * TLanes + lane;
+
+					if (ch >= mChannelCount)
+					{
+						break;
+					}
+
+					const BiQuadCoefficients& target = mTargets[ch * mSectionCount + s];
+					T scale = (T)1. / mRampLength;
+
+					sec.mStep[0][lane] = ((T)target.mB0 - sec.mCoeff[0][lane]) * scale;
+					sec.mStep[1][lane] = ((T)target.mB1 - sec.mCoeff[1][lane]) * scale;
+					sec.mStep[2][lane] = ((T)target.mB2 - sec.mCoeff[2][lane]) * scale;
+					sec.mStep[3][lane] = ((T)target.mA1 - sec.mCoeff[3][lane]) * scale;
+					sec.mStep[4][lane] = ((T)target.mA2 - sec.mCoeff[4][lane]) * scale;
+				}
+			}
+
+			mRampRemaining[group] = mRampLength;
+		}
+
+		// Immediate change without ramp (initial setup, after reset)
+		void setCoefficientsImmediately(size_t channel, size_t section, const BiQuadCoefficients& coefficients)
+		{
+			mTargets[channel * mSectionCount + section] = coefficients;
+			snapToTargets(channel / TLanes);
+		}
+
+		void reset()
+		{
+			for (size_t i = 0; i < mSections.size(); ++i)
+			{
+				std::fill(mSections[i].mZ1, mSections[i].mZ1 + TLanes, (T)0.);
+				std::fill(mSections[i].mZ2, mSections[i].mZ2 + TLanes, (T)0.);
+			}
+		}
+
+		// In place, channels[c][i]. Each channel goes through its own cascade.
+		void process(T* const* channels, size_t sampleCount)
+		{
+			T x[TLanes];
+
+			for (size_t group = 0; group < mGroupCount; ++group)
+			{
+				size_t first = group * TLanes;
+				size_t lanes = std::min(TLanes, mChannelCount - first);
+
+				for (size_t i = 0; i < sampleCount; ++i)
+				{
+					for (size_t lane = 0; lane < TLanes; ++lane)
+					{
+						x[lane] = lane < lanes ? channels[first + lane][i] : (T)0.;
+					}
+
+					processFrame(group, x);
+
+					for (size_t lane = 0; lane < lanes; ++lane)
+					{
+						channels[first + lane][i] = x[lane];
+					}
+				}
+			}
+		}
+
+		// Same input into every channel (e.g. analysis filterbank with one band per channel), outputs[c][i]
+		void processBands(const T* input, T* const* outputs, size_t sampleCount)
+		{
+			T x[TLanes];
+
+			for (size_t group = 0; group < mGroupCount; ++group)
+			{
+				size_t first = group * TLanes;
+				size_t lanes = std::min(TLanes, mChannelCount - first);
+
+				for (size_t i = 0; i < sampleCount; ++i)
+				{
+					std::fill(x, x + TLanes, input[i]);
+
+					processFrame(group, x);
+
+					for (size_t lane = 0; lane < lanes; ++lane)
+					{
+						outputs[first + lane][i] = x[lane];
+					}
+				}
+			}
+		}
+
+		// Response of the whole cascade of given channel, using target coefficients (where ramps are heading)
+		void calculateResponseDb(size_t channel, const double* frequencies, double* magnitudesDb, size_t count, double sampleRate)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				double total = 0.;
+
+				for (size_t s = 0; s < mSectionCount; ++s)
+				{
+					total += mTargets[channel * mSectionCount + s].getMagnitudeDb(frequencies[i], sampleRate);
+				}
+
+				magnitudesDb[i] = total;
+			}
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(BiQuadBank);
+
+		struct Section
+		{
+			Section()
+			{
+				for (size_t lane = 0; lane < TLanes; ++lane)
+				{
+					mCoeff[0][lane] = 1.;
+					mCoeff[1][lane] = mCoeff[2][lane] = mCoeff[3][lane] = mCoeff[4][lane] = 0.;
+
+					for (int k = 0; k < 5; ++k)
+					{
+						mStep[k][lane] = 0.;
+					}
+
+					mZ1[lane] = mZ2[lane] = 0.;
+				}
+			}
+
+			T mCoeff[5][TLanes]; // b0, b1, b2, a1, a2
+			T mStep[5][TLanes];
+			T mZ1[TLanes];
+			T mZ2[TLanes];
+		};
+
+		Section& getSection(size_t group, size_t section) { return mSections[group * mSectionCount + section]; }
+
+		forcedinline void processFrame(size_t group, T* x)
+		{
+			bool ramping = mRampRemaining[group] > 0;
+
+			for (size_t s = 0; s < mSectionCount; ++s)
+			{
+				Section& sec = getSection(group, s);
+
+				if (ramping)
+				{
+					for (int k = 0; k < 5; ++k)
+					{
+						for (size_t lane = 0; lane < TLanes; ++lane)
+						{
+							sec.mCoeff[k][lane] += sec.mStep[k][lane];
+						}
+					}
+				}
+
+				for (size_t lane = 0; lane < TLanes; ++lane)
+				{
+					T in = x[lane];
+					T out = sec.mCoeff[0][lane] * in + sec.mZ1[lane];
+
+					sec.mZ1[lane] = sec.mCoeff[1][lane] * in - sec.mCoeff[3][lane] * out + sec.mZ2[lane];
+					sec.mZ2[lane] = sec.mCoeff[2][lane] * in - sec.mCoeff[4][lane] * out;
+
+					x[lane] = out;
+				}
+			}
+
+			// Exact targets at the end, accumulated steps drift a bit
+			if (ramping && --mRampRemaining[group] == 0)
+			{
+				snapToTargets(group);
+			}
+		}
+
+		void snapToTargets(size_t group)
+		{
+			for (size_t s = 0; s < mSectionCount; ++s)
+			{
+				Section& sec = getSection(group, s);
+
+				for (size_t lane = 0; lane < TLanes; ++lane)
+				{
+					size_t ch = group * TLanes + lane;
+					const BiQuadCoefficients& target = ch < mChannelCount ? mTargets[ch * mSectionCount + s] : BiQuadCoefficients();
+
+					sec.mCoeff[0][lane] = (T)target.mB0;
+					sec.mCoeff[1][lane] = (T)target.mB1;
+					sec.mCoeff[2][lane] = (T)target.mB2;
+					sec.mCoeff[3][lane] = (T)target.mA1;
+					sec.mCoeff[4][lane] = (T)target.mA2;
+
+					for (int k = 0; k < 5; ++k)
+					{
+						sec.mStep[k][lane] = 0.;
+					}
+				}
+			}
+
+			mRampRemaining[group] = 0;
+		}
+
+		size_t mChannelCount;
+		size_t mSectionCount;
+		size_t mGroupCount;
+		size_t mRampLength;
+		std::vector<Section> mSections;
+		std::vector<BiQuadCoefficients> mTargets;
+		std::vector<size_t> mRampRemaining;
+	};
+
+}}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <cmath>
+#include <limits>
 
 namespace tomatl { namespace dsp {
 
@@ -47,6 +48,33 @@ public:
 		subject.second += angle;
 	}
 
+	// Polynomial atan2 approximation, max error is about 2e-6 rad. Written without branches (selects only),
+	// so loops calling it over arrays of bins get vectorized by the compiler.
+	static forcedinline T fastAtan2(T y, T x)
+	{
+		T ax = std::abs(x);
+		T ay = std::abs(y);
+		T mx = std::max(ax, ay);
+		T mn = std::min(ax, ay);
+		T a = mn / (mx + std::numeric_limits<T>::min());
+		T s = a * a;
+		T r = a * (0.99997726 + s * (-0.33262347 + s * (0.19354346 + s * (-0.11643287 + s * (0.05265332 + s * -0.01172120)))));
+
+		r = (ay > ax) ? (T)(TOMATL_PI / 2.) - r : r;
+		r = (x < 0) ? (T)TOMATL_PI - r : r;
+		r = (y < 0) ? -r : r;
+
+		return r;
+	}
+
+	static void fastAtan2(const T* y, const T* x, T* result, size_t length)
+	{
+		for (size_t i = 0; i < length; ++i)
+		{
+			result[i] = fastAtan2(y[i], x[i]);
+		}
+	}
+
 private:
 	Coord()
 	{
@@ -0,0 +1,172 @@
+#ifndef TOMATL_DECIMATOR
+#define TOMATL_DECIMATOR
+
+#include <vector>
+#include <cmath>
+
+namespace tomatl { namespace dsp {
+
+	// Sample rate reduction by a power of two, as a cascade of half-band FIR stages each decimating by 2.
+	// Half-band filters have every other tap equal to zero and are symmetric, so one output of a stage costs
+	// (taps + 1) / 4 multiplications, and since each stage runs at half the rate of the previous one, the whole
+	// cascade costs less than twice its first stage.
+	//
+	// Intended for feeding analyzers with a low band: e.g. SpectroCalculator at 1024 points after decimation by 32
+	// resolves 1.5 Hz at 48 kHz input, for 1/64 of CPU and latency of the same resolution at full rate. The analyzer has
+	// to be given getOutputSampleRate() as its sample rate, and its blocks then carry the effective rate to the grid.
+	// Band below 0.4 of output rate is clean: with default length everything folding into it (0.6 of output rate and up)
+	// is at least 90 dB down, and passband ripple is under 0.001 dB. 47 tap stages reach -90 dB only from about 0.65
+	// of output rate, i.e. the clean band shrinks to about 0.35 of it.
+	template <typename T> class Decimator
+	{
+	public:
+		// factor is rounded down to a power of two, taps per stage to 4k + 3
+		Decimator(size_t factor, size_t tapsPerStage = 63)
+		{
+			size_t k = std::max((size_t)1, (tapsPerStage + 1) / 4);
+			mTapCount = 4 * k - 1;
+			mCenter = (mTapCount - 1) / 2;
+
+			calculateCoefficients();
+
+			mFactor = 1;
+
+			while (mFactor * 2 <= std::max((size_t)1, factor))
+			{
+				mFactor *= 2;
+				mStages.push_back(Stage(mTapCount));
+			}
+		}
+
+		size_t getFactor() { return mFactor; }
+
+		double getOutputSampleRate(double inputSampleRate) { return inputSampleRate / mFactor; }
+
+		// Group delay in input samples
+		size_t getLatency()
+		{
+			size_t result = 0;
+
+			for (size_t i = 0; i < mStages.size(); ++i)
+			{
+				result += mCenter << i;
+			}
+
+			return result;
+		}
+
+		void reset()
+		{
+			for (size_t i = 0; i < mStages.size(); ++i)
+			{
+				mStages[i] = Stage(mTapCount);
+			}
+		}
+
+		// output must have room for count / getFactor() + 1 samples, returns number written
+		size_t process(const T* input, size_t count, T* output)
+		{
+			TOMATL_RT_SCOPE();
+
+			size_t produced = 0;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				T value = input[i];
+				bool ready = true;
+
+				for (size_t s = 0; s < mStages.size() && ready; ++s)
+				{
+					ready = push(mStages[s], value);
+				}
+
+				if (ready)
+				{
+					output[produced++] = value;
+				}
+			}
+
+			return produced;
+		}
+
+	private:
+		struct Stage
+		{
+			Stage(size_t tapCount) : mHistory(tapCount * 2, 0.), mPosition(0), mOdd(false)
+			{
+			}
+
+			// Written twice (at i and i + tapCount), so the newest tapCount samples are always contiguous
+			std::vector<T> mHistory;
+			size_t mPosition;
+			bool mOdd;
+		};
+
+		// Kaiser-windowed half-band sinc, only taps at odd distances from the center are stored
+		void calculateCoefficients()
+		{
+			WindowTable<double> window(WindowFunctionFactory::windowKaiser, mTapCount, false, 9.);
+			double sum = 0.5 * window.getData()[mCenter];
+
+			mCoefficients.clear();
+
+			for (size_t offset = 1; offset <= mCenter; offset += 2)
+			{
+				double t = offset / 2.;
+				double value = std::sin(TOMATL_PI * t) / (TOMATL_PI * t) * 0.5 * window.getData()[mCenter + offset];
+
+				mCoefficients.push_back(value);
+				sum += 2. * value;
+			}
+
+			// Unity DC gain
+			mCenterCoefficient = (T)(0.5 * window.getData()[mCenter] / sum);
+
+			for (size_t i = 0; i < mCoefficients.size(); ++i)
+			{
+				mCoefficients[i] = (T)(mCoefficients[i] / sum);
+			}
+		}
+
+		// Pushes one sample into the stage, returns true (and replaces value with the output) on every second one
+		forcedinline bool push(Stage& stage, T& value)
+		{
+			const size_t tapCount = mTapCount;
+
+			stage.mPosition = (stage.mPosition + tapCount - 1) % tapCount;
+			stage.mHistory[stage.mPosition] = stage.mHistory[stage.mPosition + tapCount] = value;
+
+			stage.mOdd = !stage.mOdd;
+
+			if (stage.mOdd)
+			{
+				return false;
+			}
+
+			// x[n - j] is history[j], symmetric pairs around the center
+			const T* x = &stage.mHistory[stage.mPosition];
+			T acc = mCenterCoefficient * x[mCenter];
+
+			for (size_t k = 0; k < mCoefficients.size(); ++k)
+			{
+				size_t offset = 2 * k + 1;
+
+				acc += mCoefficients[k] * (x[mCenter - offset] + x[mCenter + offset]);
+			}
+
+			value = acc;
+
+			return true;
+		}
+
+		size_t mFactor;
+		size_t mTapCount;
+		size_t mCenter;
+		T mCenterCoefficient;
+		std::vector<T> mCoefficients;
+		std::vector<Stage> mStages;
+	};
+
+}}
+
+#endif
@@ -48,6 +48,15 @@ public:
 		In that case, the transform of the frequencies of interest is in fftBuffer[0...fftFrameSize].
 		*/
 	{
+		// Common sizes have compile-time tables, no trig and no bit twiddling for reordering at all
+		const FixedSizeTables::TableSet* tables = FixedSizeTables::get(fftFrameSize);
+
+		if (tables != NULL)
+		{
+			calculateWithTables(fftBuffer, *tables, inverse);
+			return;
+		}
+
 		long sign = (!inverse) ? -1 : 1;
 		T wr, wi, arg, *p1, *p2, temp;
 		T tr, ti, ur, ui, *p1r, *p1i, *p2r, *p2i;
@@ -103,6 +112,73 @@ public:
 			}
 		}
 	}
+
+	// Forward transform where only bins [firstBin, endBin) are needed, other bins are left with garbage.
+	// Output k of decimation-in-time transform only depends on butterflies with index k mod half in each stage,
+	// so stages whose half is larger than the range width skip most of their butterflies. That's the last
+	// log2(fftFrameSize / (endBin - firstBin)) stages, the rest is as expensive as the full transform.
+	// Sizes without baked tables fall back to calculateFast().
+	static void calculatePruned(T* fftBuffer, long fftFrameSize, size_t firstBin, size_t endBin)
+	{
+		const FixedSizeTables::TableSet* tables = FixedSizeTables::get(fftFrameSize);
+
+		if (tables != NULL)
+		{
+			calculateWithTables(fftBuffer, *tables, false, firstBin, endBin);
+		}
+		else
+		{
+			calculateFast(fftBuffer, fftFrameSize, false);
+		}
+	}
+
+private:
+	// Same radix-2 decimation-in-time transform as above, but with table lookups for bit-reversed order and twiddles.
+	// As a bonus, twiddles are exact instead of accumulating recurrence error.
+	static void calculateWithTables(T* fftBuffer, const FixedSizeTables::TableSet& tables, bool inverse, size_t firstBin = 0, size_t endBin = 0)
+	{
+		const size_t size = tables.mSize;
+		const T sign = (!inverse) ? -1 : 1;
+		const size_t neededCount = (endBin > firstBin) ? std::min(endBin - firstBin, size) : size;
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			size_t j = tables.mBitReverse[i];
+
+			if (i < j)
+			{
+				std::swap(fftBuffer[i * 2], fftBuffer[j * 2]);
+				std::swap(fftBuffer[i * 2 + 1], fftBuffer[j * 2 + 1]);
+			}
+		}
+
+		for (size_t half = 1; half < size; half <<= 1)
+		{
+			const size_t step = size / (half * 2);
+			const bool pruned = neededCount < half;
+
+			for (size_t n = 0; n < (pruned ? neededCount : half); ++n)
+			{
+				const size_t j = pruned ? (firstBin + n) % half : n;
+				const T ur = (T)tables.cos2Pi(j * step);
+				const T ui = sign * (T)tables.sin2Pi(j * step);
+
+				for (size_t i = j; i < size; i += half * 2)
+				{
+					T* p1 = fftBuffer + i * 2;
+					T* p2 = fftBuffer + (i + half) * 2;
+
+					T tr = p2[0] * ur - p2[1] * ui;
+					T ti = p2[0] * ui + p2[1] * ur;
+
+					p2[0] = p1[0] - tr;
+					p2[1] = p1[1] - ti;
+					p1[0] += tr;
+					p1[1] += ti;
+				}
+			}
+		}
+	}
 };
 
 }}
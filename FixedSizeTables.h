@@ -0,0 +1,140 @@
+#ifndef TOMATL_FIXED_SIZE_TABLES
+#define TOMATL_FIXED_SIZE_TABLES
+
+#include <cstdint>
+
+namespace tomatl { namespace dsp {
+
+// Trigonometry and bit-reversal tables for the frame sizes we use most (512...4096), evaluated by the compiler.
+// Everything FFT twiddles and cosine-sum windows need is sin/cos of 2 * pi * k / N, and all of it can be
+// read from a quarter-wave sine table using symmetry. Needs C++14 (loops in constexpr constructors).
+class FixedSizeTables
+{
+private:
+	FixedSizeTables(){}
+
+	// More digits than TOMATL_PI, as table values are final
+	static constexpr double pi() { return 3.14159265358979323846264338327950288; }
+
+	// Taylor series, only valid for |x| <= pi / 4, where 12 terms are way beyond double precision
+	static constexpr double sinSeries(double x)
+	{
+		double term = x;
+		double sum = x;
+
+		for (int k = 1; k < 12; ++k)
+		{
+			term *= -x * x / ((2. * k) * (2. * k + 1.));
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	static constexpr double cosSeries(double x)
+	{
+		double term = 1.;
+		double sum = 1.;
+
+		for (int k = 1; k < 12; ++k)
+		{
+			term *= -x * x / ((2. * k - 1.) * (2. * k));
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	// sin(pi / 2 * i / quarter) for i in [0, quarter]
+	static constexpr double quarterSine(size_t i, size_t quarter)
+	{
+		return (2 * i <= quarter) ? sinSeries(pi() / 2. * i / quarter) : cosSeries(pi() / 2. * (quarter - i) / quarter);
+	}
+
+	template <size_t N> struct Tables
+	{
+		constexpr Tables() : mQuarterSine(), mBitReverse()
+		{
+			for (size_t i = 0; i <= N / 4; ++i)
+			{
+				mQuarterSine[i] = quarterSine(i, N / 4);
+			}
+
+			for (size_t i = 0; i < N; ++i)
+			{
+				size_t reversed = 0;
+
+				for (size_t bit = 1, mirrored = N >> 1; bit < N; bit <<= 1, mirrored >>= 1)
+				{
+					if (i & bit) reversed |= mirrored;
+				}
+
+				mBitReverse[i] = (uint16_t)reversed;
+			}
+		}
+
+		double mQuarterSine[N / 4 + 1];
+		uint16_t mBitReverse[N];
+	};
+
+	template <size_t N> struct Storage
+	{
+		static constexpr Tables<N> sTables = Tables<N>();
+	};
+
+public:
+	struct TableSet
+	{
+		size_t mSize;
+		const double* mQuarterSine;
+		const uint16_t* mBitReverse;
+
+		// sin(2 * pi * k / mSize) for any k
+		forcedinline double sin2Pi(size_t k) const
+		{
+			const size_t quarter = mSize >> 2;
+			k &= mSize - 1;
+
+			size_t quadrant = k / quarter;
+			size_t offset = k - quadrant * quarter;
+
+			double value = (quadrant & 1) ? mQuarterSine[quarter - offset] : mQuarterSine[offset];
+
+			return (quadrant & 2) ? -value : value;
+		}
+
+		// cos(2 * pi * k / mSize) for any k
+		forcedinline double cos2Pi(size_t k) const
+		{
+			return sin2Pi(k + (mSize >> 2));
+		}
+	};
+
+	// NULL for sizes without baked tables, callers fall back to runtime calculation
+	static const TableSet* get(size_t size)
+	{
+		static const TableSet sets[] =
+		{
+			{ 512, Storage<512>::sTables.mQuarterSine, Storage<512>::sTables.mBitReverse },
+			{ 1024, Storage<1024>::sTables.mQuarterSine, Storage<1024>::sTables.mBitReverse },
+			{ 2048, Storage<2048>::sTables.mQuarterSine, Storage<2048>::sTables.mBitReverse },
+			{ 4096, Storage<4096>::sTables.mQuarterSine, Storage<4096>::sTables.mBitReverse }
+		};
+
+		for (size_t i = 0; i < sizeof(sets) / sizeof(sets[0]); ++i)
+		{
+			if (sets[i].mSize == size)
+			{
+				return &sets[i];
+			}
+		}
+
+		return NULL;
+	}
+};
+
+template <size_t N> constexpr FixedSizeTables::Tables<N> FixedSizeTables::Storage<N>::sTables;
+
+}}
+
+#endif
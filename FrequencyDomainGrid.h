@@ -2,6 +2,9 @@
 #define TOMATL_FREQUENCY_DOMAIN_GRID
 
 #include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
 
 namespace tomatl{ namespace dsp{
 
@@ -122,32 +125,60 @@ namespace tomatl{ namespace dsp{
 
 	private:
 		tomatl::dsp::OctaveScale mFreqScale;
+		tomatl::dsp::OctaveScale mFullFreqScale; // Separate instance, so full-scale conversions don't invalidate cached constants of the other one
 		tomatl::dsp::LinearScale mMagnitudeScale; // As we use dB values the scale is linear
 		tomatl::dsp::Bound2D<double> mBounds;
 		tomatl::dsp::Bound2D<double> mFullBounds;
-		double* mFreqCache;
+		std::vector<int> mBinToX;
+		std::vector<double> mBinFrequencies;
+		ParameterExchange<Bound2D<double>> mPostedBounds;
 		size_t mSampleRate;
 		size_t mBinCount;
+		double mFrequencyOffset;	// Frequency of bin 0, Hz
+		double mBinWidth;			// Hz, 0 if derived from sample rate and bin count
+		bool mSparse;				// mBinFrequencies come from the block (SparseBinTracker), not from the bin mapping
 		size_t mWidth;
 		size_t mHeight;
 		
 		FrequencyDomainGrid(){}
 		FrequencyDomainGrid(const FrequencyDomainGrid&){}
 
-		void prepareFreqCache()
+		// Column for each FFT bin, -1 for bins outside of visible frequency range. Sized to bin count,
+		// so it is small and dense, unlike per-Hz cache which used to be here.
+		void rebuildBinTable()
 		{
-			TOMATL_BRACE_DELETE(mFreqCache);
+			mBinToX.resize(mBinCount);
+			mBinFrequencies.resize(mBinCount);
 
-			if (mSampleRate > 0)
+			if (mBinCount == 0 || (mSampleRate == 0 && mBinWidth == 0. && !mSparse) || mWidth == 0)
 			{
-				mFreqCache = new double[mSampleRate];
-				memset(mFreqCache, 0x0, sizeof(double)* mSampleRate);
+				std::fill(mBinToX.begin(), mBinToX.end(), -1);
+
+				return;
 			}
-		}
 
-		forcedinline int calculateBinNumberToX(double value)
-		{
-			return mFreqScale.scale(mWidth, mBounds.X, binNumberToFrequency(value), true);
+			if (!mSparse)
+			{
+				for (size_t bin = 0; bin < mBinCount; ++bin)
+				{
+					mBinFrequencies[bin] = binNumberToFrequency(bin);
+				}
+			}
+
+			mFreqScale.prepare(mWidth, mBounds.X);
+			mFreqScale.scaleN(&mBinFrequencies[0], &mBinToX[0], mBinCount, true);
+
+			for (size_t bin = 0; bin < mBinCount; ++bin)
+			{
+				if (!isFrequencyVisible(mBinFrequencies[bin]))
+				{
+					mBinToX[bin] = -1;
+				}
+				else
+				{
+					mBinToX[bin] = std::min(mBinToX[bin], (int)mWidth - 1);
+				}
+			}
 		}
 
 		void recalcGrid()
@@ -197,11 +228,13 @@ namespace tomatl{ namespace dsp{
 			mBounds = fullBounds;
 			mSampleRate = sampleRate;
 			mBinCount = binCount;
+			mFrequencyOffset = 0.;
+			mBinWidth = 0.;
+			mSparse = false;
 			mWidth = width;
 			mHeight = height;
-			mFreqCache = NULL;
 
-			prepareFreqCache();
+			rebuildBinTable();
 		}
 
 		const tomatl::dsp::Bound2D<double>& getCurrentBounds()
@@ -215,7 +248,7 @@ namespace tomatl{ namespace dsp{
 			{
 				mHeight = h;
 				mWidth = w;
-				prepareFreqCache();
+				rebuildBinTable();
 				recalcGrid();
 
 				return true;
@@ -229,7 +262,7 @@ namespace tomatl{ namespace dsp{
 			if (sampleRate != mSampleRate)
 			{
 				mSampleRate = sampleRate;
-				prepareFreqCache();
+				rebuildBinTable();
 
 				return true;
 			}
@@ -242,8 +275,8 @@ namespace tomatl{ namespace dsp{
 			if (!mBounds.areEqual(bounds))
 			{
 				mBounds = bounds;
+				rebuildBinTable();
 				recalcGrid();
-				prepareFreqCache();
 
 				return true;
 			}
@@ -251,20 +284,148 @@ namespace tomatl{ namespace dsp{
 			return false;
 		}
 
+		// Follows sample rate, size and frequency mapping of the analyzer output. Analyzers fed through Decimator
+		// (or other rate changes) report their effective rate in blocks, zoom analyzers also report frequency of
+		// their first bin, so bins land on correct frequencies without extra bookkeeping.
+		bool updateFromBlock(const SpectrumBlock& block)
+		{
+			// Analyzers return empty blocks between frames, they say nothing about the mapping
+			if (block.mData == NULL || block.mLength == 0)
+			{
+				return false;
+			}
+
+			if (block.mSparse || mSparse)
+			{
+				return updateSparseFrequencies(block);
+			}
+
+			bool changed = false;
+
+			if (block.mSampleRate != 0)
+			{
+				changed = updateSampleRate(block.mSampleRate);
+			}
+
+			if (block.mBinWidth != mBinWidth || block.mFrequencyOffset != mFrequencyOffset)
+			{
+				updateFrequencyMapping(block.mFrequencyOffset, block.mBinWidth);
+				changed = true;
+			}
+
+			if (block.mLength != mBinCount)
+			{
+				updateBinCount(block.mLength);
+				changed = true;
+			}
+
+			return changed;
+		}
+
+		// Control thread. Bounds are applied by the thread which owns the grid at its next applyPostedBounds()
+		// (reduceToColumns() does it on entry), so bin table is never rebuilt under a running reduction.
+		void postBounds(Bound2D<double> bounds)
+		{
+			mPostedBounds.post(bounds);
+		}
+
+		bool applyPostedBounds()
+		{
+			return mPostedBounds.pickUp() && updateBounds(mPostedBounds.current());
+		}
+
+		// Sparse blocks carry frequency of every bin, table is rebuilt only when they change
+		bool updateSparseFrequencies(const SpectrumBlock& block)
+		{
+			bool changed = block.mSparse != mSparse || block.mLength != mBinCount;
+
+			for (size_t bin = 0; bin < block.mLength && !changed && block.mSparse; ++bin)
+			{
+				changed = block.mData[bin].first != mBinFrequencies[bin];
+			}
+
+			if (!changed)
+			{
+				return false;
+			}
+
+			mSparse = block.mSparse;
+			mBinCount = block.mLength;
+			mFrequencyOffset = block.mFrequencyOffset;
+			mBinWidth = block.mBinWidth;
+
+			if (block.mSampleRate != 0)
+			{
+				mSampleRate = block.mSampleRate;
+			}
+
+			if (mSparse)
+			{
+				mBinFrequencies.resize(mBinCount);
+
+				for (size_t bin = 0; bin < mBinCount; ++bin)
+				{
+					mBinFrequencies[bin] = block.mData[bin].first;
+				}
+			}
+
+			rebuildBinTable();
+
+			return true;
+		}
+
+		// Bin i is at frequencyOffset + i * binWidth. binWidth of 0 restores usual real FFT mapping (DC to Nyquist).
+		void updateFrequencyMapping(double frequencyOffset, double binWidth)
+		{
+			if (frequencyOffset != mFrequencyOffset || binWidth != mBinWidth)
+			{
+				mFrequencyOffset = frequencyOffset;
+				mBinWidth = binWidth;
+				rebuildBinTable();
+			}
+		}
+
 		void updateBinCount(size_t binCount)
 		{
 			if (binCount != mBinCount)
 			{
 				mBinCount = binCount;
+				rebuildBinTable();
 			}
 		}
 
+		// Bins [first, end) which land inside current frequency bounds, plus one on each side for interpolation of
+		// the edge columns. To be registered with SpectroCalculator::setBinRange(), so zoomed-in views don't pay
+		// for the bins they don't show. Empty range until bin count and size are known.
+		std::pair<size_t, size_t> getVisibleBinRange()
+		{
+			size_t first = mBinCount;
+			size_t end = 0;
+
+			for (size_t bin = 0; bin < mBinToX.size(); ++bin)
+			{
+				if (mBinToX[bin] >= 0)
+				{
+					first = std::min(first, bin);
+					end = bin + 1;
+				}
+			}
+
+			if (first >= end)
+			{
+				return std::pair<size_t, size_t>(0, 0);
+			}
+
+			return std::pair<size_t, size_t>(first > 0 ? first - 1 : 0, std::min(end + 1, mBinCount));
+		}
+
 		bool containsPoint(int x, int y) { return x <= getWidth() && y <= getHeight(); }
 
 		bool isFrequencyVisible(const double& freq) { return TOMATL_IS_IN_BOUNDS_INCLUSIVE(freq, mBounds.X.mLow, mBounds.X.mHigh); }
 
 		size_t getWidth() { return mWidth; }
 		size_t getHeight() { return mHeight; }
+		size_t getSampleRate() { return mSampleRate; }
 
 		size_t getFreqLineCount() { return mFreqGrid.size(); }
 		size_t getAmplLineCount() { return mAmplGrid.size(); }
@@ -274,23 +435,29 @@ namespace tomatl{ namespace dsp{
 
 		forcedinline double binNumberToFrequency(const double& value)
 		{
+			if (mSparse)
+			{
+				return mBinFrequencies.empty() ? 0. : mBinFrequencies[std::min((size_t)(std::max(0., value) + 0.5), mBinFrequencies.size() - 1)];
+			}
+
+			if (mBinWidth > 0.)
+			{
+				return mFrequencyOffset + value * mBinWidth;
+			}
+
 			// Bin count * 2 is just a weird way of getting FFT size
 			return value * mSampleRate / (mBinCount * 2);
 		}
 
 		forcedinline int freqToX(const double& value)
 		{
-			if (mFreqCache == NULL)
-			{
-				return mFreqScale.scale(mWidth, mBounds.X, value, true);
-			}
-
-			if (mFreqCache[(int)value] == 0)
-			{
-				mFreqCache[(int)value] = mFreqScale.scale(mWidth, mBounds.X, value, true);
-			}
+			return mFreqScale.scale(mWidth, mBounds.X, value, true);
+		}
 
-			return mFreqCache[(int)value];
+		// -1 if bin is not visible
+		forcedinline int binToX(size_t bin)
+		{
+			return bin < mBinToX.size() ? mBinToX[bin] : -1;
 		}
 
 		forcedinline double xToFreq(const int& x)
@@ -326,12 +493,101 @@ namespace tomatl{ namespace dsp{
 
 		forcedinline double fullScaleXToFreq(const double& value)
 		{
-			return mFreqScale.unscale(mWidth, mFullBounds.X, value, true);
+			return mFullFreqScale.unscale(mWidth, mFullBounds.X, value, true);
+		}
+
+		struct ColumnValue
+		{
+			double mMin;			// Smallest bin magnitude falling into the column
+			double mMax;			// Largest one
+			double mPeakFrequency;	// Frequency of the largest one
+			size_t mBinCount;		// 0 if no bins fall into column and values are interpolated from neighbours
+		};
+
+		// Collapses spectrum frame into one entry per pixel column (columns must have getWidth() entries).
+		// Low frequencies on octave scale have several columns per bin, such columns are linearly interpolated,
+		// so result can be drawn directly. Sparse blocks only populate columns of tracked frequencies, gaps between
+		// unrelated frequencies aren't interpolated. Returns number of columns which have data.
+		size_t reduceToColumns(const SpectrumBlock& block, ColumnValue* columns)
+		{
+			applyPostedBounds();
+			updateFromBlock(block);
+
+			for (size_t x = 0; x < mWidth; ++x)
+			{
+				columns[x].mMin = std::numeric_limits<double>::max();
+				columns[x].mMax = 0.;
+				columns[x].mPeakFrequency = 0.;
+				columns[x].mBinCount = 0;
+			}
+
+			const size_t binCount = (block.mData != NULL) ? std::min(mBinCount, block.mLength) : 0;
+
+			for (size_t bin = 0; bin < binCount; ++bin)
+			{
+				int x = mBinToX[bin];
+
+				if (x >= 0)
+				{
+					ColumnValue& column = columns[x];
+					const double& value = block.mData[bin].second;
+
+					column.mMin = std::min(column.mMin, value);
+
+					if (value >= column.mMax)
+					{
+						column.mMax = value;
+						column.mPeakFrequency = mBinFrequencies[bin];
+					}
+
+					++column.mBinCount;
+				}
+			}
+
+			// Fill gaps between populated columns
+			int previous = -1;
+			size_t populated = 0;
+
+			for (int x = 0; x < (int)mWidth; ++x)
+			{
+				if (columns[x].mBinCount == 0)
+				{
+					continue;
+				}
+
+				++populated;
+
+				if (previous >= 0 && x - previous > 1 && !mSparse)
+				{
+					const ColumnValue& a = columns[previous];
+					const ColumnValue& b = columns[x];
+
+					for (int gap = previous + 1; gap < x; ++gap)
+					{
+						double t = (double)(gap - previous) / (x - previous);
+
+						columns[gap].mMin = columns[gap].mMax = a.mMax + (b.mMax - a.mMax) * t;
+						columns[gap].mPeakFrequency = xToFreq(gap);
+					}
+				}
+
+				previous = x;
+			}
+
+			// Whatever is left empty at the edges has nothing to show
+			for (size_t x = 0; x < mWidth; ++x)
+			{
+				if (columns[x].mMin == std::numeric_limits<double>::max())
+				{
+					columns[x].mMin = 0.;
+				}
+			}
+
+			return populated;
 		}
 
 		~FrequencyDomainGrid()
 		{
-			TOMATL_BRACE_DELETE(mFreqCache);
 		}
 		
 		std::wstring getPointNotation(int x, int y)
@@ -402,7 +658,7 @@ namespace tomatl{ namespace dsp{
 		std::vector<GridLine> mAmplGrid;
 	};
 
-	/*class EqualizerGrid : public FrequencyDomainGrid
+	class EqualizerGrid : public FrequencyDomainGrid
 	{
 	public:
 
@@ -416,9 +672,28 @@ namespace tomatl{ namespace dsp{
 		size_t getPointCount() { return mPoints.size(); }
 
 		FrequencyDomainFilter* getPoint(int index) { return mPoints[index]; }
+
+		// Overlay curve: Y coordinate of summed response of all points for each of getWidth() columns
+		void calculateResponseCurve(int* columnsY)
+		{
+			double sampleRate = getSampleRate();
+
+			for (size_t x = 0; x < getWidth(); ++x)
+			{
+				double frequency = xToFreq(x);
+				double totalDb = 0.;
+
+				for (size_t i = 0; i < mPoints.size(); ++i)
+				{
+					totalDb += mPoints[i]->getMagnitudeDb(frequency, sampleRate);
+				}
+
+				columnsY[x] = dbToY(totalDb);
+			}
+		}
 	private:
 		std::vector<tomatl::dsp::FrequencyDomainFilter*> mPoints;
-	};*/
+	};
 }}
 
 #endif
\ No newline at end of file
@@ -7,8 +7,30 @@ namespace tomatl { namespace dsp {
 template<typename T> class GonioCalculator
 {
 public:
+	// Stages of handleBlock() measured per chunk when compiled with TOMATL_ENABLE_PROFILING
+	enum ProfileStage
+	{
+		profileMeter = 0,
+		profileTransform,
+		profileStageCount
+	};
+
+	// Settings which may be changed from another thread through postParameters()
+	struct Parameters
+	{
+		Parameters(bool customScaleEnabled = false, double customScale = 1., double releaseMs = 5000.)
+			: mCustomScaleEnabled(customScaleEnabled), mCustomScale(customScale), mReleaseMs(releaseMs)
+		{
+		}
+
+		bool mCustomScaleEnabled;
+		double mCustomScale;
+		double mReleaseMs;
+	};
+
 	GonioCalculator(size_t segmentLength = 512, size_t sampleRate = 48000, std::pair<double, double> autoAttackRelease = std::pair<double, double>(0.01, 5000))
-		: mData(NULL), mProcCounter(0), mCustomScaleEnabled(false), mLastScale(1.), mCustomScale(1.)
+		: mData(NULL), mProcCounter(0), mCustomScaleEnabled(false), mLastScale(1.), mCustomScale(1.),
+		mParameters(Parameters(false, 1., autoAttackRelease.second))
 	{
 		setSegmentLength(segmentLength);
 		mSqrt2 = std::pow(2., 0.5);
@@ -23,8 +45,22 @@ public:
 		mEnvelope.setReleaseSpeed(value);
 	}
 
+	// Control thread. Direct setters are only safe on the thread which calls handlePoint(), posted set is picked up
+	// as a whole at the start of the next segment, so scale never changes in the middle of one.
+	void postParameters(const Parameters& params)
+	{
+		mParameters.post(params);
+	}
+
 	std::pair<T, T>* handlePoint(const std::pair<T, T>& subject, size_t sampleRate)
 	{
+		TOMATL_RT_SCOPE();
+
+		if (mProcCounter == 0)
+		{
+			applyPostedParameters();
+		}
+
 		std::pair<T, T> point(subject);
 		mEnvelope.setSampleRate(sampleRate);
 		
@@ -66,6 +102,53 @@ public:
 		return handlePoint(point, sampleRate);
 	}
 
+	// Block version of handlePoint() which also feeds the meter (if any) in the same pass: input is walked in small chunks,
+	// so meter sums and goniometer both read samples while they are still in cache.
+	// Handler is called as handler(std::pair<T, T>* segment, size_t length) for every completed segment.
+	template <typename THandler> void handleBlock(const T* left, const T* right, size_t count, size_t sampleRate, StereoMeter<T>* meter, THandler handler)
+	{
+		TOMATL_RT_SCOPE();
+
+		const size_t chunkLength = 256;
+
+		if (meter != NULL)
+		{
+			meter->setSampleRate(sampleRate);
+		}
+
+		for (size_t start = 0; start < count; start += chunkLength)
+		{
+			size_t length = std::min(chunkLength, count - start);
+
+			TOMATL_PROFILE_START(mProfiler);
+
+			if (meter != NULL)
+			{
+				meter->process(left + start, right + start, length);
+				TOMATL_PROFILE_LAP(mProfiler, profileMeter);
+			}
+
+			for (size_t i = start; i < start + length; ++i)
+			{
+				std::pair<T, T>* segment = handlePoint(left[i], right[i], sampleRate);
+
+				if (segment != NULL)
+				{
+					handler(segment, mSegmentLength);
+				}
+			}
+
+			// Includes segment handler, as it's called from the same loop
+			TOMATL_PROFILE_LAP(mProfiler, profileTransform);
+		}
+	}
+
+	// Empty unless compiled with TOMATL_ENABLE_PROFILING
+	ProfileSnapshot getProfile(ProfileStage stage)
+	{
+		return mProfiler.getSnapshot(stage);
+	}
+
 	GonioCalculator& setSegmentLength(size_t segmentLength)
 	{
 		TOMATL_DELETE(mData);
@@ -93,6 +176,18 @@ public:
 	void setCustomScale(double value) { mCustomScale = TOMATL_BOUND_VALUE(value, 0., 1.); }
 
 private:
+	void applyPostedParameters()
+	{
+		if (mParameters.pickUp())
+		{
+			const Parameters& params = mParameters.current();
+
+			setCustomScaleEnabled(params.mCustomScaleEnabled);
+			setCustomScale(params.mCustomScale);
+			setReleaseSpeed(params.mReleaseMs);
+		}
+	}
+
 	size_t mSegmentLength;
 	std::pair<T, T>* mData;
 	unsigned int mProcCounter;
@@ -101,6 +196,8 @@ private:
 	double mCustomScale;
 	double mLastScale;
 	tomatl::dsp::EnvelopeWalker mEnvelope;
+	ParameterExchange<Parameters> mParameters;
+	StageProfiler<profileStageCount> mProfiler;
 };
 
 }}
@@ -0,0 +1,190 @@
+#ifndef TOMATL_GONIO_RASTERIZER
+#define TOMATL_GONIO_RASTERIZER
+
+#include <vector>
+#include <cstdint>
+#include <type_traits>
+#include <limits>
+
+namespace tomatl { namespace dsp {
+
+// Bins goniometer points straight into a fixed-size intensity image with exponential persistence,
+// so drawing cost depends on image size and not on sample rate.
+//
+// TPixel may be floating point or unsigned integer. With floating point pixels decay is exact: instead of fading
+// the whole image every sample, each new hit gets exponentially growing weight and the image is faded once per
+// publish, which is the same thing up to a common factor. If persistence is so short that the weight would
+// outgrow float range before the next publish, the image is faded early, whenever the weight passes cMaxHitWeight.
+// Integer pixels get saturating fixed-intensity hits and fixed-point fade once per publish.
+//
+// Threading: accumulate()/publish() on one (audio or analysis) thread, acquire() on renderer thread.
+// Images are triple-buffered, handoff is triple_buffer, nothing allocates after construction.
+template <typename TPixel> class GonioRasterizer
+{
+public:
+	GonioRasterizer(size_t width, size_t height, double persistenceMs = 150., double publishIntervalMs = 1000. / 60.)
+		: mWidth(width), mHeight(height), mPersistenceMs(persistenceMs), mPublishIntervalMs(publishIntervalMs),
+		mSampleRate(0.), mDecayPerSample(1.), mGrowthPerSample(1.), mHitWeight(1.), mSamplesSincePublish(0), mPublishIntervalSamples(0),
+		mImage(width * height, 0), mExchange(mImage)
+	{
+
+		mHitIntensity = std::is_floating_point<TPixel>::value ? (TPixel)1 : (TPixel)(std::numeric_limits<TPixel>::max() / 16);
+	}
+
+	// Time for a lone point to fade to 1% (same semantics as EnvelopeWalker release)
+	void setPersistence(double persistenceMs)
+	{
+		mPersistenceMs = persistenceMs;
+		mSampleRate = 0.;
+	}
+
+	void setPublishInterval(double intervalMs)
+	{
+		mPublishIntervalMs = intervalMs;
+		mSampleRate = 0.;
+	}
+
+	// Only used for integer pixels, floating point ones add 1 per hit
+	void setHitIntensity(TPixel value) { mHitIntensity = value; }
+
+	size_t getWidth() { return mWidth; }
+	size_t getHeight() { return mHeight; }
+
+	// Points in [-1, 1] x [-1, 1] as GonioCalculator produces them, one point per sample
+	template <typename T> void accumulate(const std::pair<T, T>* points, size_t count, double sampleRate)
+	{
+		checkSampleRate(sampleRate);
+
+		const double halfWidth = (mWidth - 1) * 0.5;
+		const double halfHeight = (mHeight - 1) * 0.5;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			// Positive Y is up
+			int x = (int)((points[i].first + 1.) * halfWidth + 0.5);
+			int y = (int)((1. - points[i].second) * halfHeight + 0.5);
+
+			x = TOMATL_BOUND_VALUE(x, 0, (int)mWidth - 1);
+			y = TOMATL_BOUND_VALUE(y, 0, (int)mHeight - 1);
+
+			addHit(mImage[y * mWidth + x], std::is_floating_point<TPixel>());
+
+			++mSamplesSincePublish;
+
+			if (mSamplesSincePublish >= mPublishIntervalSamples)
+			{
+				publish();
+			}
+		}
+	}
+
+	// Applies pending fade and hands current image over to the renderer
+	void publish()
+	{
+		fadeImage(std::is_floating_point<TPixel>());
+
+		mSamplesSincePublish = 0;
+		mHitWeight = 1.;
+
+		std::copy(mImage.begin(), mImage.end(), mExchange.back().begin());
+		mExchange.publish();
+	}
+
+	// Latest published image, row-major, getWidth() * getHeight() pixels. Stays valid until next acquire().
+	const TPixel* acquire()
+	{
+		mExchange.update();
+
+		return &mExchange.front()[0];
+	}
+
+	void clear()
+	{
+		std::fill(mImage.begin(), mImage.end(), (TPixel)0);
+		mHitWeight = 1.;
+	}
+
+private:
+	TOMATL_DECLARE_NON_MOVABLE_COPYABLE(GonioRasterizer);
+
+	// Hit weight at which float image is renormalized, leaves plenty of float range for the sum of hits
+	static constexpr double cMaxHitWeight = 1e6;
+
+	void checkSampleRate(double sampleRate)
+	{
+		if (sampleRate != mSampleRate)
+		{
+			mSampleRate = sampleRate;
+
+			// At least one sample, so a single step of weight growth stays bounded (by 100)
+			double persistenceMs = std::max(mPersistenceMs, 1000. / sampleRate);
+
+			mDecayPerSample = EnvelopeWalker::calculateCoeff(persistenceMs, sampleRate);
+			mGrowthPerSample = 1. / mDecayPerSample;
+			mPublishIntervalSamples = std::max((size_t)1, (size_t)(mPublishIntervalMs * 0.001 * sampleRate));
+		}
+	}
+
+	forcedinline void addHit(TPixel& pixel, std::true_type)
+	{
+		pixel += (TPixel)mHitWeight;
+		mHitWeight *= mGrowthPerSample;
+
+		if (mHitWeight > cMaxHitWeight)
+		{
+			fadeImage(std::true_type());
+			mHitWeight = 1.;
+		}
+	}
+
+	forcedinline void addHit(TPixel& pixel, std::false_type)
+	{
+		pixel = (pixel > std::numeric_limits<TPixel>::max() - mHitIntensity) ? std::numeric_limits<TPixel>::max() : (TPixel)(pixel + mHitIntensity);
+	}
+
+	void fadeImage(std::true_type)
+	{
+		const TPixel decay = (TPixel)(1. / mHitWeight);
+		TPixel* image = &mImage[0];
+		const size_t size = mImage.size();
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			image[i] *= decay;
+		}
+	}
+
+	void fadeImage(std::false_type)
+	{
+		typedef typename std::conditional<sizeof(TPixel) <= 2, uint32_t, uint64_t>::type Wide;
+
+		const Wide decay = (Wide)(std::pow(mDecayPerSample, (double)mSamplesSincePublish) * 65536.);
+		TPixel* image = &mImage[0];
+		const size_t size = mImage.size();
+
+		for (size_t i = 0; i < size; ++i)
+		{
+			image[i] = (TPixel)(((Wide)image[i] * decay) >> 16);
+		}
+	}
+
+	size_t mWidth;
+	size_t mHeight;
+	double mPersistenceMs;
+	double mPublishIntervalMs;
+	double mSampleRate;
+	double mDecayPerSample;
+	double mGrowthPerSample;
+	double mHitWeight;
+	size_t mSamplesSincePublish;
+	size_t mPublishIntervalSamples;
+	TPixel mHitIntensity;
+	std::vector<TPixel> mImage;
+	triple_buffer<std::vector<TPixel>> mExchange;
+};
+
+template <typename TPixel> constexpr double GonioRasterizer<TPixel>::cMaxHitWeight;
+
+}}
+
+#endif
@@ -0,0 +1,338 @@
+#ifndef TOMATL_LOUDNESS_METER
+#define TOMATL_LOUDNESS_METER
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+namespace tomatl { namespace dsp {
+
+	// ITU-R BS.1770-4 / EBU R128 loudness: momentary (400 ms), short-term (3 s), gated integrated loudness and
+	// loudness range (EBU Tech 3342).
+	//
+	// All channels are K-weighted together in one BiQuadBank. Filtered power is summed into 100 ms sub-blocks, and
+	// momentary/short-term windows are sums of the last 4/30 sub-blocks (which is the 75% overlap gating block grid).
+	// Gating needs every block loudness since reset, which is kept as a histogram with 0.1 dB bins instead of a list,
+	// so memory is constant however long the meter runs. Bins also keep energy sums, so gated means are exact and only
+	// gate thresholds are quantized to bins.
+	template <typename T> class LoudnessMeter
+	{
+	public:
+		LoudnessMeter(size_t channelCount, double sampleRate)
+			: mChannelCount(channelCount), mFilter(channelCount, 2, 1), mSampleRate(0.)
+		{
+			mChannelWeights.assign(channelCount, 1.);
+			mScratch.assign(channelCount, std::vector<T>(cChunkLength));
+			mScratchPointers.resize(channelCount);
+
+			for (size_t c = 0; c < channelCount; ++c)
+			{
+				mScratchPointers[c] = &mScratch[c][0];
+			}
+
+			mBlockHistogram.assign(cHistogramBins, 0);
+			mBlockEnergies.assign(cHistogramBins, 0.);
+			mShortTermHistogram.assign(cHistogramBins, 0);
+			mShortTermEnergies.assign(cHistogramBins, 0.);
+
+			setSampleRate(sampleRate);
+		}
+
+		// 1.0 for L/R/C, 1.41 for surround channels, 0 to exclude (LFE)
+		void setChannelWeight(size_t channel, double weight) { mChannelWeights[channel] = weight; }
+
+		void setSampleRate(double sampleRate)
+		{
+			if (sampleRate == mSampleRate)
+			{
+				return;
+			}
+
+			mSampleRate = sampleRate;
+			mSubBlockLength = std::max((size_t)1, (size_t)std::floor(sampleRate * 0.1 + 0.5));
+
+			for (size_t c = 0; c < mChannelCount; ++c)
+			{
+				mFilter.setCoefficientsImmediately(c, 0, calculatePreFilter(sampleRate));
+				mFilter.setCoefficientsImmediately(c, 1, calculateRlbFilter(sampleRate));
+			}
+
+			reset();
+		}
+
+		void reset()
+		{
+			mFilter.reset();
+			std::fill(mSubBlocks, mSubBlocks + cShortTermSubBlocks, 0.);
+			mSubBlockCount = 0;
+			mSubBlockPosition = 0;
+			mCurrentSum = 0.;
+			resetIntegrated();
+		}
+
+		// Restarts integrated loudness and range only, momentary and short-term keep running
+		void resetIntegrated()
+		{
+			std::fill(mBlockHistogram.begin(), mBlockHistogram.end(), 0);
+			std::fill(mBlockEnergies.begin(), mBlockEnergies.end(), 0.);
+			std::fill(mShortTermHistogram.begin(), mShortTermHistogram.end(), 0);
+			std::fill(mShortTermEnergies.begin(), mShortTermEnergies.end(), 0.);
+		}
+
+		// channels[c][i], input is not modified
+		void process(const T* const* channels, size_t sampleCount)
+		{
+			TOMATL_RT_SCOPE();
+
+			for (size_t start = 0; start < sampleCount; )
+			{
+				// Chunks never cross sub-block boundary, so sub-block sums are closed right after filtering
+				size_t length = std::min(std::min(cChunkLength, sampleCount - start), mSubBlockLength - mSubBlockPosition);
+
+				for (size_t c = 0; c < mChannelCount; ++c)
+				{
+					std::copy(channels[c] + start, channels[c] + start + length, mScratchPointers[c]);
+				}
+
+				mFilter.process(&mScratchPointers[0], length);
+
+				for (size_t c = 0; c < mChannelCount; ++c)
+				{
+					if (mChannelWeights[c] == 0.)
+					{
+						continue;
+					}
+
+					const T* data = mScratchPointers[c];
+					double sum[4] = { 0., 0., 0., 0. };
+					size_t i = 0;
+
+					for (; i + 4 <= length; i += 4)
+					{
+						for (size_t lane = 0; lane < 4; ++lane)
+						{
+							sum[lane] += (double)data[i + lane] * data[i + lane];
+						}
+					}
+
+					for (; i < length; ++i)
+					{
+						sum[0] += (double)data[i] * data[i];
+					}
+
+					mCurrentSum += mChannelWeights[c] * (sum[0] + sum[1] + sum[2] + sum[3]);
+				}
+
+				mSubBlockPosition += length;
+				start += length;
+
+				if (mSubBlockPosition >= mSubBlockLength)
+				{
+					closeSubBlock();
+				}
+			}
+		}
+
+		double getMomentaryLufs() { return toLufs(getWindowEnergy(cMomentarySubBlocks)); }
+		double getShortTermLufs() { return toLufs(getWindowEnergy(cShortTermSubBlocks)); }
+
+		double getIntegratedLufs()
+		{
+			// Histogram only holds blocks above the absolute gate, so that pass starts from the first bin
+			double absoluteGated = getGatedEnergy(mBlockHistogram, mBlockEnergies, 0);
+
+			if (absoluteGated <= 0.)
+			{
+				return -std::numeric_limits<double>::infinity();
+			}
+
+			return toLufs(getGatedEnergy(mBlockHistogram, mBlockEnergies, std::max(0, binIndex(toLufs(absoluteGated) - 10.))));
+		}
+
+		// LU, difference between 95th and 10th percentiles of relative gated short-term loudness
+		double getLoudnessRange()
+		{
+			double absoluteGated = getGatedEnergy(mShortTermHistogram, mShortTermEnergies, 0);
+
+			if (absoluteGated <= 0.)
+			{
+				return 0.;
+			}
+
+			int firstBin = std::max(0, binIndex(toLufs(absoluteGated) - 20.));
+			size_t total = 0;
+
+			for (int i = firstBin; i < cHistogramBins; ++i)
+			{
+				total += mShortTermHistogram[i];
+			}
+
+			if (total == 0)
+			{
+				return 0.;
+			}
+
+			return getPercentile(firstBin, total, 0.95) - getPercentile(firstBin, total, 0.10);
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(LoudnessMeter);
+
+		static constexpr size_t cChunkLength = 256;
+		static const size_t cMomentarySubBlocks = 4;
+		static const size_t cShortTermSubBlocks = 30;
+
+		// -70 LUFS (absolute gate) ... +10 LUFS in 0.1 dB steps
+		static const int cHistogramBins = 800;
+		static constexpr double cHistogramLow = -70.;
+		static constexpr double cHistogramStep = 0.1;
+
+		// BS.1770 stage 1 (high shelf modelling the head) and stage 2 (RLB high pass), bilinear designs valid for any rate
+		static BiQuadCoefficients calculatePreFilter(double sampleRate)
+		{
+			const double f0 = 1681.974450955533;
+			const double gainDb = 3.999843853973347;
+			const double q = 0.7071752369554196;
+
+			double k = std::tan(TOMATL_PI * f0 / sampleRate);
+			double vh = std::pow(10., gainDb / 20.);
+			double vb = std::pow(vh, 0.4996667741545416);
+
+			return BiQuadCoefficients(vh + vb * k / q + k * k, 2. * (k * k - vh), vh - vb * k / q + k * k,
+				1. + k / q + k * k, 2. * (k * k - 1.), 1. - k / q + k * k);
+		}
+
+		static BiQuadCoefficients calculateRlbFilter(double sampleRate)
+		{
+			const double f0 = 38.13547087602444;
+			const double q = 0.5003270373238773;
+
+			double k = std::tan(TOMATL_PI * f0 / sampleRate);
+			double a0 = 1. + k / q + k * k;
+
+			return BiQuadCoefficients(a0, -2. * a0, a0, a0, 2. * (k * k - 1.), 1. - k / q + k * k);
+		}
+
+		static double toLufs(double energy)
+		{
+			return energy > 0. ? -0.691 + 10. * std::log10(energy) : -std::numeric_limits<double>::infinity();
+		}
+
+		static int binIndex(double lufs)
+		{
+			return (int)std::floor((lufs - cHistogramLow) / cHistogramStep);
+		}
+
+		static double binCenter(int bin)
+		{
+			return cHistogramLow + (bin + 0.5) * cHistogramStep;
+		}
+
+		void closeSubBlock()
+		{
+			mSubBlocks[mSubBlockCount % cShortTermSubBlocks] = mCurrentSum / mSubBlockLength;
+			++mSubBlockCount;
+			mCurrentSum = 0.;
+			mSubBlockPosition = 0;
+
+			if (mSubBlockCount >= cMomentarySubBlocks)
+			{
+				addToHistogram(mBlockHistogram, mBlockEnergies, getWindowEnergy(cMomentarySubBlocks));
+			}
+
+			if (mSubBlockCount >= cShortTermSubBlocks)
+			{
+				addToHistogram(mShortTermHistogram, mShortTermEnergies, getWindowEnergy(cShortTermSubBlocks));
+			}
+		}
+
+		static void addToHistogram(std::vector<size_t>& histogram, std::vector<double>& energies, double energy)
+		{
+			double lufs = toLufs(energy);
+
+			// Absolute gate
+			if (lufs > cHistogramLow)
+			{
+				int bin = std::min(binIndex(lufs), cHistogramBins - 1);
+
+				histogram[bin]++;
+				energies[bin] += energy;
+			}
+		}
+
+		double getWindowEnergy(size_t subBlocks)
+		{
+			size_t available = std::min(subBlocks, mSubBlockCount);
+
+			if (available == 0)
+			{
+				return 0.;
+			}
+
+			double sum = 0.;
+
+			for (size_t i = 0; i < available; ++i)
+			{
+				sum += mSubBlocks[(mSubBlockCount - 1 - i) % cShortTermSubBlocks];
+			}
+
+			// Windows aren't full during the first seconds - average over what we have
+			return sum / available;
+		}
+
+		// Mean energy of blocks in bins from firstBin up
+		static double getGatedEnergy(const std::vector<size_t>& histogram, const std::vector<double>& energies, int firstBin)
+		{
+			double sum = 0.;
+			size_t count = 0;
+
+			for (int i = firstBin; i < cHistogramBins; ++i)
+			{
+				sum += energies[i];
+				count += histogram[i];
+			}
+
+			return count > 0 ? sum / count : 0.;
+		}
+
+		double getPercentile(int firstBin, size_t total, double fraction)
+		{
+			size_t target = (size_t)std::ceil(total * fraction);
+			size_t accumulated = 0;
+
+			for (int i = firstBin; i < cHistogramBins; ++i)
+			{
+				accumulated += mShortTermHistogram[i];
+
+				if (accumulated >= target && accumulated > 0)
+				{
+					return binCenter(i);
+				}
+			}
+
+			return binCenter(cHistogramBins - 1);
+		}
+
+		size_t mChannelCount;
+		BiQuadBank<T> mFilter;
+		double mSampleRate;
+		size_t mSubBlockLength;
+		size_t mSubBlockPosition;
+		size_t mSubBlockCount;
+		double mCurrentSum;
+		double mSubBlocks[cShortTermSubBlocks];
+		std::vector<double> mChannelWeights;
+		std::vector<std::vector<T>> mScratch;
+		std::vector<T*> mScratchPointers;
+		std::vector<size_t> mBlockHistogram;
+		std::vector<double> mBlockEnergies;
+		std::vector<size_t> mShortTermHistogram;
+		std::vector<double> mShortTermEnergies;
+	};
+
+	template <typename T> constexpr size_t LoudnessMeter<T>::cChunkLength;
+
+}}
+
+#endif
@@ -0,0 +1,322 @@
+#ifndef TOMATL_METER_BANK
+#define TOMATL_METER_BANK
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace tomatl { namespace dsp {
+
+	// Linear values, use TOMATL_TO_DB for display
+	struct MeterReading
+	{
+		MeterReading() : mSamplePeak(0.), mTruePeak(0.), mRms(0.), mPeakHold(0.), mTruePeakMax(0.)
+		{
+		}
+
+		double mSamplePeak;		// With release ballistics
+		double mTruePeak;		// Inter-sample peak estimate (4x oversampled), with release ballistics
+		double mRms;			// Over the RMS window
+		double mPeakHold;		// Max of true peak, held for hold time
+		double mTruePeakMax;	// Since reset
+	};
+
+	// Peak/true peak/RMS metering for many channels. Channels are processed in groups of TLanes with structure of arrays
+	// state, so every per-sample operation (abs, max, square, interpolation filter taps) runs over lanes and compiles to SIMD.
+	//
+	// True peak follows BS.1770 annex 2: 4x polyphase interpolation with a Kaiser-windowed sinc, 12 taps per phase.
+	// Peak release uses EnvelopeWalker coefficients applied once per block (attack is instant, as meters do).
+	// RMS window is rectangular, built from 30 sub-block sums, so its memory doesn't depend on window length.
+	//
+	// process() is for the audio thread, acquireReadings() gives the UI consistent per-channel readings via triple_buffer.
+	template <typename T, size_t TLanes = 4> class MeterBank
+	{
+	public:
+		MeterBank(size_t channelCount, double sampleRate, double releaseMs = 1500., double rmsWindowMs = 300., double holdMs = 2000.)
+			: mChannelCount(channelCount), mSampleRate(sampleRate), mReleaseMs(releaseMs), mRmsWindowMs(rmsWindowMs), mHoldMs(holdMs),
+			mReadings(channelCount), mExchange(std::vector<MeterReading>(channelCount))
+		{
+			mGroupCount = (channelCount + TLanes - 1) / TLanes;
+			mGroups.resize(mGroupCount);
+			mSubBlocks.assign(channelCount * cRmsSubBlocks, 0.);
+			mHoldRemaining.assign(channelCount, 0);
+
+			calculateInterpolationFilter();
+			setSampleRate(sampleRate);
+		}
+
+		void setSampleRate(double sampleRate)
+		{
+			mSampleRate = sampleRate;
+			mReleaseCoeff = EnvelopeWalker::calculateCoeff(mReleaseMs, sampleRate);
+			mSubBlockLength = std::max((size_t)1, (size_t)(mRmsWindowMs * 0.001 * sampleRate / cRmsSubBlocks));
+			mHoldSamples = mHoldMs < 0. ? -1 : (long long)(mHoldMs * 0.001 * sampleRate);
+			reset();
+		}
+
+		void setReleaseTime(double releaseMs)
+		{
+			mReleaseMs = releaseMs;
+			mReleaseCoeff = EnvelopeWalker::calculateCoeff(mReleaseMs, mSampleRate);
+		}
+
+		// Rounded to 1/30 of window, restarts RMS
+		void setRmsWindow(double windowMs)
+		{
+			mRmsWindowMs = windowMs;
+			setSampleRate(mSampleRate);
+		}
+
+		// Negative means hold until reset()
+		void setHoldTime(double holdMs)
+		{
+			mHoldMs = holdMs;
+			mHoldSamples = mHoldMs < 0. ? -1 : (long long)(mHoldMs * 0.001 * mSampleRate);
+		}
+
+		void reset()
+		{
+			mGroups.assign(mGroupCount, Group());
+			std::fill(mSubBlocks.begin(), mSubBlocks.end(), 0.);
+			std::fill(mHoldRemaining.begin(), mHoldRemaining.end(), 0);
+			std::fill(mReadings.begin(), mReadings.end(), MeterReading());
+			mSubBlockPosition = 0;
+			mSubBlockIndex = 0;
+			mHistoryPosition = 0;
+		}
+
+		// channels[c][i]
+		void process(const T* const* channels, size_t sampleCount)
+		{
+			TOMATL_RT_SCOPE();
+
+			for (size_t start = 0; start < sampleCount; )
+			{
+				size_t length = std::min(sampleCount - start, mSubBlockLength - mSubBlockPosition);
+				size_t historyPosition = mHistoryPosition;
+
+				for (size_t group = 0; group < mGroupCount; ++group)
+				{
+					historyPosition = processGroup(group, channels, start, length);
+				}
+
+				mHistoryPosition = historyPosition;
+				mSubBlockPosition += length;
+				start += length;
+
+				applyBallistics(length);
+
+				if (mSubBlockPosition >= mSubBlockLength)
+				{
+					closeSubBlock();
+				}
+			}
+
+			mExchange.back() = mReadings;
+			mExchange.publish();
+		}
+
+		// Audio thread
+		const MeterReading& getReading(size_t channel) { return mReadings[channel]; }
+
+		// UI thread, getChannelCount() entries, valid until the next call
+		const MeterReading* acquireReadings()
+		{
+			mExchange.update();
+
+			return &mExchange.front()[0];
+		}
+
+		size_t getChannelCount() { return mChannelCount; }
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(MeterBank);
+
+		static const size_t cPhases = 4;
+		static const size_t cTapsPerPhase = 12;
+		static const size_t cRmsSubBlocks = 30;
+
+		struct Group
+		{
+			Group()
+			{
+				for (size_t lane = 0; lane < TLanes; ++lane)
+				{
+					mPeak[lane] = mTruePeak[lane] = 0.;
+					mSquares[lane] = 0.;
+
+					for (size_t k = 0; k < cTapsPerPhase * 2; ++k)
+					{
+						mHistory[k][lane] = 0.;
+					}
+				}
+			}
+
+			// Written twice (at i and i + cTapsPerPhase), so the newest cTapsPerPhase samples are always contiguous
+			T mHistory[cTapsPerPhase * 2][TLanes];
+			T mPeak[TLanes];
+			T mTruePeak[TLanes];
+			double mSquares[TLanes];
+		};
+
+		void calculateInterpolationFilter()
+		{
+			const size_t length = cPhases * cTapsPerPhase;
+			const double center = (length - 1) / 2.;
+			WindowTable<double> window(WindowFunctionFactory::windowKaiser, length, false, 6.);
+
+			for (size_t n = 0; n < length; ++n)
+			{
+				double t = (n - center) / cPhases;
+				double sinc = (t == 0.) ? 1. : std::sin(TOMATL_PI * t) / (TOMATL_PI * t);
+
+				mTaps[n % cPhases][n / cPhases] = (T)(sinc * window.getData()[n]);
+			}
+
+			// Unity DC gain for every phase
+			for (size_t p = 0; p < cPhases; ++p)
+			{
+				T sum = 0.;
+
+				for (size_t k = 0; k < cTapsPerPhase; ++k) sum += mTaps[p][k];
+				for (size_t k = 0; k < cTapsPerPhase; ++k) mTaps[p][k] /= sum;
+			}
+		}
+
+		// Returns history position after the block (same for all groups)
+		size_t processGroup(size_t group, const T* const* channels, size_t start, size_t length)
+		{
+			Group& g = mGroups[group];
+			size_t first = group * TLanes;
+			size_t lanes = std::min(TLanes, mChannelCount - first);
+			size_t position = mHistoryPosition;
+
+			for (size_t i = 0; i < length; ++i)
+			{
+				T x[TLanes];
+
+				for (size_t lane = 0; lane < TLanes; ++lane)
+				{
+					x[lane] = lane < lanes ? channels[first + lane][start + i] : (T)0.;
+				}
+
+				position = (position + cTapsPerPhase - 1) % cTapsPerPhase;
+
+				for (size_t lane = 0; lane < TLanes; ++lane)
+				{
+					g.mHistory[position][lane] = g.mHistory[position + cTapsPerPhase][lane] = x[lane];
+					g.mPeak[lane] = std::max(g.mPeak[lane], std::abs(x[lane]));
+					g.mSquares[lane] += (double)x[lane] * x[lane];
+				}
+
+				for (size_t p = 0; p < cPhases; ++p)
+				{
+					T acc[TLanes] = { 0. };
+
+					for (size_t k = 0; k < cTapsPerPhase; ++k)
+					{
+						const T tap = mTaps[p][k];
+						const T* h = g.mHistory[position + k];
+
+						for (size_t lane = 0; lane < TLanes; ++lane)
+						{
+							acc[lane] += tap * h[lane];
+						}
+					}
+
+					for (size_t lane = 0; lane < TLanes; ++lane)
+					{
+						g.mTruePeak[lane] = std::max(g.mTruePeak[lane], std::abs(acc[lane]));
+					}
+				}
+			}
+
+			return position;
+		}
+
+		void applyBallistics(size_t length)
+		{
+			const double release = std::pow(mReleaseCoeff, (double)length);
+
+			for (size_t c = 0; c < mChannelCount; ++c)
+			{
+				Group& g = mGroups[c / TLanes];
+				size_t lane = c % TLanes;
+				MeterReading& r = mReadings[c];
+
+				double peak = g.mPeak[lane];
+				double truePeak = g.mTruePeak[lane];
+
+				r.mSamplePeak = std::max(peak, r.mSamplePeak * release);
+				r.mTruePeak = std::max(truePeak, r.mTruePeak * release);
+				r.mTruePeakMax = std::max(truePeak, r.mTruePeakMax);
+
+				if (truePeak >= r.mPeakHold)
+				{
+					r.mPeakHold = truePeak;
+					mHoldRemaining[c] = mHoldSamples;
+				}
+				else if (mHoldSamples >= 0)
+				{
+					mHoldRemaining[c] -= (long long)length;
+
+					if (mHoldRemaining[c] <= 0)
+					{
+						r.mPeakHold = r.mTruePeak;
+					}
+				}
+
+				g.mPeak[lane] = g.mTruePeak[lane] = 0.;
+			}
+		}
+
+		void closeSubBlock()
+		{
+			const double norm = 1. / (mSubBlockLength * cRmsSubBlocks);
+
+			for (size_t c = 0; c < mChannelCount; ++c)
+			{
+				Group& g = mGroups[c / TLanes];
+				size_t lane = c % TLanes;
+				double* ring = &mSubBlocks[c * cRmsSubBlocks];
+
+				ring[mSubBlockIndex] = g.mSquares[lane];
+				g.mSquares[lane] = 0.;
+
+				double sum = 0.;
+
+				for (size_t i = 0; i < cRmsSubBlocks; ++i)
+				{
+					sum += ring[i];
+				}
+
+				mReadings[c].mRms = std::sqrt(sum * norm);
+			}
+
+			mSubBlockIndex = (mSubBlockIndex + 1) % cRmsSubBlocks;
+			mSubBlockPosition = 0;
+		}
+
+		size_t mChannelCount;
+		size_t mGroupCount;
+		double mSampleRate;
+		double mReleaseMs;
+		double mRmsWindowMs;
+		double mHoldMs;
+		double mReleaseCoeff;
+		long long mHoldSamples;
+		size_t mSubBlockLength;
+		size_t mSubBlockPosition;
+		size_t mSubBlockIndex;
+		size_t mHistoryPosition;
+		T mTaps[cPhases][cTapsPerPhase];
+		std::vector<Group> mGroups;
+		std::vector<double> mSubBlocks;
+		std::vector<long long> mHoldRemaining;
+		std::vector<MeterReading> mReadings;
+		triple_buffer<std::vector<MeterReading>> mExchange;
+	};
+
+}}
+
+#endif
@@ -0,0 +1,137 @@
+#ifndef TOMATL_MULTITAPER_ESTIMATOR
+#define TOMATL_MULTITAPER_ESTIMATOR
+
+#include <vector>
+
+namespace tomatl { namespace dsp {
+
+	// Thomson multitaper spectrum estimate: frame is multiplied by K orthogonal DPSS tapers, and power spectra of
+	// all tapered copies are averaged. Each taper gives (nearly) independent estimate, so variance drops about K times
+	// from a single frame, which is what otherwise takes averaging of K frames (and their latency).
+	//
+	// Tapered copies are real, so they are transformed two per complex FFT (one in real part, one in imaginary)
+	// and separated afterwards, K tapers cost ceil(K / 2) FFTs.
+	template <typename T> class MultitaperEstimator
+	{
+	public:
+		// taperCount of 0 means the usual 2 * NW - 1
+		MultitaperEstimator(size_t fftSize, double timeBandwidth = 4., size_t taperCount = 0)
+		{
+			mFftSize = fftSize;
+			mTimeBandwidth = timeBandwidth;
+
+			if (taperCount == 0)
+			{
+				taperCount = (size_t)std::max(1., std::floor(2. * timeBandwidth) - 1.);
+			}
+
+			mTapers = DpssCalculator<T>::calculate(fftSize, timeBandwidth, taperCount);
+
+			// Same amplitude reference as Hann-windowed SpectroCalculator path: a sine in the middle of a bin reads its
+			// amplitude. Its averaged power is proportional to mean of squared taper sums (odd tapers sum to zero),
+			// so tapers are scaled for that mean to be N^2.
+			double sumOfSquares = 0.;
+
+			for (size_t k = 0; k < mTapers.size(); ++k)
+			{
+				double sum = 0.;
+
+				for (size_t i = 0; i < fftSize; ++i)
+				{
+					sum += mTapers[k][i];
+				}
+
+				sumOfSquares += sum * sum;
+			}
+
+			T scale = (T)(fftSize / std::sqrt(sumOfSquares / mTapers.size()));
+
+			for (size_t k = 0; k < mTapers.size(); ++k)
+			{
+				for (size_t i = 0; i < fftSize; ++i)
+				{
+					mTapers[k][i] *= scale;
+				}
+			}
+
+			mScratch.resize(fftSize * 2);
+			mPower.resize(fftSize / 2);
+		}
+
+		size_t getTaperCount() { return mTapers.size(); }
+		size_t getFftSize() { return mFftSize; }
+		double getTimeBandwidth() { return mTimeBandwidth; }
+
+		// Reads mFftSize real samples (signal[0], signal[stride], ...) and writes mFftSize / 2 magnitudes on the same
+		// scale as SpectroCalculator (sine reads its amplitude). Noise floor is a bit higher than with Hann window,
+		// as multitaper estimate has wider equivalent noise bandwidth.
+		void calculate(const T* signal, size_t stride, T* magnitudes)
+		{
+			const size_t binCount = mFftSize / 2;
+			const size_t taperCount = mTapers.size();
+			T* z = &mScratch[0];
+
+			std::fill(mPower.begin(), mPower.end(), 0.);
+
+			for (size_t k = 0; k < taperCount; k += 2)
+			{
+				const T* first = &mTapers[k][0];
+				const T* second = (k + 1 < taperCount) ? &mTapers[k + 1][0] : NULL;
+
+				for (size_t i = 0; i < mFftSize; ++i)
+				{
+					T sample = signal[i * stride];
+
+					z[i * 2] = sample * first[i];
+					z[i * 2 + 1] = (second != NULL) ? sample * second[i] : 0.;
+				}
+
+				FftCalculator<T>::calculateFast(z, mFftSize);
+
+				if (second == NULL)
+				{
+					for (size_t bin = 0; bin < binCount; ++bin)
+					{
+						mPower[bin] += z[bin * 2] * z[bin * 2] + z[bin * 2 + 1] * z[bin * 2 + 1];
+					}
+				}
+				else
+				{
+					// X[k] = (Z[k] + conj(Z[N - k])) / 2, Y[k] = (Z[k] - conj(Z[N - k])) / 2j
+					for (size_t bin = 0; bin < binCount; ++bin)
+					{
+						const T* a = z + bin * 2;
+						const T* b = z + ((mFftSize - bin) % mFftSize) * 2;
+
+						T xRe = a[0] + b[0];
+						T xIm = a[1] - b[1];
+						T yRe = a[1] + b[1];
+						T yIm = b[0] - a[0];
+
+						mPower[bin] += 0.25 * (xRe * xRe + xIm * xIm + yRe * yRe + yIm * yIm);
+					}
+				}
+			}
+
+			const double norm = 2. / mFftSize;
+			const double average = 1. / taperCount;
+
+			for (size_t bin = 0; bin < binCount; ++bin)
+			{
+				magnitudes[bin] = (T)(std::sqrt(mPower[bin] * average) * norm);
+			}
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(MultitaperEstimator);
+
+		std::vector<std::vector<T>> mTapers;
+		std::vector<T> mScratch;
+		std::vector<double> mPower;
+		size_t mFftSize;
+		double mTimeBandwidth;
+	};
+
+}}
+
+#endif
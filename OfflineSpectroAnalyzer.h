@@ -0,0 +1,629 @@
+#ifndef TOMATL_OFFLINE_SPECTRO_ANALYZER
+#define TOMATL_OFFLINE_SPECTRO_ANALYZER
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace tomatl { namespace dsp {
+
+	// Read-only (or create-and-write) memory mapping of a whole file
+	class MappedFile
+	{
+	public:
+		MappedFile() : mData(NULL), mSize(0)
+		{
+#ifdef _WIN32
+			mFile = INVALID_HANDLE_VALUE;
+			mMapping = NULL;
+#else
+			mFile = -1;
+#endif
+		}
+
+		~MappedFile()
+		{
+			close();
+		}
+
+		bool openForReading(const std::string& path)
+		{
+			close();
+#ifdef _WIN32
+			mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+			LARGE_INTEGER size;
+
+			if (mFile == INVALID_HANDLE_VALUE || !GetFileSizeEx(mFile, &size) || size.QuadPart == 0)
+			{
+				close();
+				return false;
+			}
+
+			mSize = (size_t)size.QuadPart;
+			mMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+			mData = mMapping == NULL ? NULL : (char*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+			mFile = ::open(path.c_str(), O_RDONLY);
+
+			struct stat info;
+
+			if (mFile < 0 || fstat(mFile, &info) != 0 || info.st_size == 0)
+			{
+				close();
+				return false;
+			}
+
+			mSize = (size_t)info.st_size;
+			void* data = mmap(NULL, mSize, PROT_READ, MAP_SHARED, mFile, 0);
+			mData = data == MAP_FAILED ? NULL : (char*)data;
+#endif
+			if (mData == NULL)
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		// Creates (truncates) file of given size and maps it writable
+		bool openForWriting(const std::string& path, size_t size)
+		{
+			close();
+#ifdef _WIN32
+			mFile = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+			LARGE_INTEGER position;
+			position.QuadPart = size;
+
+			if (mFile == INVALID_HANDLE_VALUE || !SetFilePointerEx(mFile, position, NULL, FILE_BEGIN) || !SetEndOfFile(mFile))
+			{
+				close();
+				return false;
+			}
+
+			mSize = size;
+			mMapping = CreateFileMappingA(mFile, NULL, PAGE_READWRITE, 0, 0, NULL);
+			mData = mMapping == NULL ? NULL : (char*)MapViewOfFile(mMapping, FILE_MAP_WRITE, 0, 0, 0);
+#else
+			mFile = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+			if (mFile < 0 || ftruncate(mFile, size) != 0)
+			{
+				close();
+				return false;
+			}
+
+			mSize = size;
+			void* data = mmap(NULL, mSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFile, 0);
+			mData = data == MAP_FAILED ? NULL : (char*)data;
+#endif
+			if (mData == NULL)
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void close()
+		{
+#ifdef _WIN32
+			if (mData != NULL) UnmapViewOfFile(mData);
+			if (mMapping != NULL) CloseHandle(mMapping);
+			if (mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+
+			mMapping = NULL;
+			mFile = INVALID_HANDLE_VALUE;
+#else
+			if (mData != NULL) munmap(mData, mSize);
+			if (mFile >= 0) ::close(mFile);
+
+			mFile = -1;
+#endif
+			mData = NULL;
+			mSize = 0;
+		}
+
+		char* getData() { return mData; }
+		size_t getSize() { return mSize; }
+		bool isOpen() { return mData != NULL; }
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(MappedFile);
+
+		char* mData;
+		size_t mSize;
+#ifdef _WIN32
+		HANDLE mFile;
+		HANDLE mMapping;
+#else
+		int mFile;
+#endif
+	};
+
+	struct PcmFormat
+	{
+		enum SampleType
+		{
+			sampleInt16 = 0,
+			sampleInt24,
+			sampleInt32,
+			sampleFloat32,
+			sampleFloat64
+		};
+
+		PcmFormat() : mType(sampleInt16), mChannelCount(2), mSampleRate(44100)
+		{
+		}
+
+		PcmFormat(SampleType type, size_t channelCount, size_t sampleRate) : mType(type), mChannelCount(channelCount), mSampleRate(sampleRate)
+		{
+		}
+
+		size_t getBytesPerSample() const
+		{
+			const size_t sizes[] = { 2, 3, 4, 4, 8 };
+
+			return sizes[mType];
+		}
+
+		size_t getBytesPerFrame() const { return getBytesPerSample() * mChannelCount; }
+
+		SampleType mType;
+		size_t mChannelCount;
+		size_t mSampleRate;
+	};
+
+	// Interleaved little-endian PCM sample frames backed by memory-mapped WAV or headerless file.
+	// Reading is stateless, so any number of threads may read different ranges concurrently.
+	class PcmFileView
+	{
+	public:
+		PcmFileView() : mSamples(NULL), mFrameCount(0)
+		{
+		}
+
+		bool openWav(const std::string& path)
+		{
+			if (!mFile.openForReading(path) || mFile.getSize() < 12)
+			{
+				return false;
+			}
+
+			const char* data = mFile.getData();
+			size_t size = mFile.getSize();
+
+			if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+			{
+				return false;
+			}
+
+			bool formatFound = false;
+			size_t position = 12;
+
+			while (position + 8 <= size)
+			{
+				const char* chunk = data + position;
+				size_t chunkSize = readLittleEndian<uint32_t>(chunk + 4);
+				const char* body = chunk + 8;
+
+				if (memcmp(chunk, "fmt ", 4) == 0 && chunkSize >= 16)
+				{
+					uint16_t formatTag = readLittleEndian<uint16_t>(body);
+					uint16_t bits = readLittleEndian<uint16_t>(body + 14);
+
+					// WAVE_FORMAT_EXTENSIBLE keeps actual format tag in first two bytes of SubFormat GUID
+					if (formatTag == 0xFFFE && chunkSize >= 40)
+					{
+						formatTag = readLittleEndian<uint16_t>(body + 24);
+					}
+
+					mFormat.mChannelCount = readLittleEndian<uint16_t>(body + 2);
+					mFormat.mSampleRate = readLittleEndian<uint32_t>(body + 4);
+
+					if (formatTag == 1 && bits == 16) mFormat.mType = PcmFormat::sampleInt16;
+					else if (formatTag == 1 && bits == 24) mFormat.mType = PcmFormat::sampleInt24;
+					else if (formatTag == 1 && bits == 32) mFormat.mType = PcmFormat::sampleInt32;
+					else if (formatTag == 3 && bits == 32) mFormat.mType = PcmFormat::sampleFloat32;
+					else if (formatTag == 3 && bits == 64) mFormat.mType = PcmFormat::sampleFloat64;
+					else return false;
+
+					formatFound = mFormat.mChannelCount > 0;
+				}
+				else if (memcmp(chunk, "data", 4) == 0 && formatFound)
+				{
+					// Truncated files are common for recordings which were interrupted, take whatever is there
+					size_t available = std::min(chunkSize, size - position - 8);
+
+					mSamples = body;
+					mFrameCount = available / mFormat.getBytesPerFrame();
+
+					return true;
+				}
+
+				// Chunks are word-aligned
+				position += 8 + chunkSize + (chunkSize & 1);
+			}
+
+			return false;
+		}
+
+		bool openRaw(const std::string& path, const PcmFormat& format, size_t headerBytes = 0)
+		{
+			if (!mFile.openForReading(path) || mFile.getSize() < headerBytes || format.mChannelCount == 0)
+			{
+				return false;
+			}
+
+			mFormat = format;
+			mSamples = mFile.getData() + headerBytes;
+			mFrameCount = (mFile.getSize() - headerBytes) / mFormat.getBytesPerFrame();
+
+			return true;
+		}
+
+		const PcmFormat& getFormat() { return mFormat; }
+		size_t getFrameCount() { return mFrameCount; }
+
+		// Converts frames [start, start + count) to interleaved floating point in [-1, 1)
+		template <typename T> size_t readFrames(size_t start, size_t count, T* destination)
+		{
+			if (start >= mFrameCount)
+			{
+				return 0;
+			}
+
+			count = std::min(count, mFrameCount - start);
+
+			const size_t sampleCount = count * mFormat.mChannelCount;
+			const size_t sampleSize = mFormat.getBytesPerSample();
+			const char* source = mSamples + start * mFormat.getBytesPerFrame();
+
+			for (size_t i = 0; i < sampleCount; ++i, source += sampleSize)
+			{
+				switch (mFormat.mType)
+				{
+				case PcmFormat::sampleInt16:
+					destination[i] = (T)(int16_t)readLittleEndian<uint16_t>(source) * (T)(1. / 32768.);
+					break;
+				case PcmFormat::sampleInt24:
+					// Place 24 bits into upper part of 32 bit integer, so sign is taken care of
+					destination[i] = (T)(int32_t)((uint32_t)(uint8_t)source[0] << 8 | (uint32_t)(uint8_t)source[1] << 16 | (uint32_t)(uint8_t)source[2] << 24) * (T)(1. / 2147483648.);
+					break;
+				case PcmFormat::sampleInt32:
+					destination[i] = (T)(int32_t)readLittleEndian<uint32_t>(source) * (T)(1. / 2147483648.);
+					break;
+				case PcmFormat::sampleFloat32:
+				{
+					float value;
+					memcpy(&value, source, sizeof(value));
+					destination[i] = (T)value;
+					break;
+				}
+				case PcmFormat::sampleFloat64:
+				{
+					double value;
+					memcpy(&value, source, sizeof(value));
+					destination[i] = (T)value;
+					break;
+				}
+				}
+			}
+
+			return count;
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(PcmFileView);
+
+		template <typename TInt> static TInt readLittleEndian(const char* source)
+		{
+			TInt result = 0;
+
+			for (size_t i = 0; i < sizeof(TInt); ++i)
+			{
+				result |= (TInt)((TInt)(uint8_t)source[i] << (8 * i));
+			}
+
+			return result;
+		}
+
+		MappedFile mFile;
+		PcmFormat mFormat;
+		const char* mSamples;
+		size_t mFrameCount;
+	};
+
+	// Receives analyzer output. consume() is called concurrently from worker threads and frames of different
+	// chunks arrive out of order, frameNumber is the absolute hop number (same as a live analyzer would count).
+	class OfflineAnalysisSink
+	{
+	public:
+		virtual bool prepare(size_t frameCount, size_t binCount, size_t sampleRate, size_t hopSize) = 0;
+		virtual void consume(size_t frameNumber, const SpectrumBlock& block) = 0;
+		virtual void finish() {}
+		virtual ~OfflineAnalysisSink() {}
+	};
+
+	// Writes one float32 row per frame into a memory-mapped file, each frame lands at its own offset,
+	// so workers never contend. Rows are either all bins or band values (RMS of magnitudes between band edges).
+	//
+	// Layout: "TSPC", then uint32 header values (version, frameCount, columnCount, sampleRate, hopSize),
+	// then columnCount float32 band lower edges in Hz (zero for bin output), then frames.
+	class SpectrumFileWriter : public OfflineAnalysisSink
+	{
+	public:
+		SpectrumFileWriter(const std::string& path, const std::vector<double>& bandEdges = std::vector<double>())
+			: mPath(path), mBandEdges(bandEdges), mFrameCount(0), mColumnCount(0), mBinCount(0), mRows(NULL)
+		{
+		}
+
+		virtual bool prepare(size_t frameCount, size_t binCount, size_t sampleRate, size_t hopSize)
+		{
+			mFrameCount = frameCount;
+			mBinCount = binCount;
+			mBandStart.clear();
+
+			if (mBandEdges.size() >= 2)
+			{
+				double binWidth = sampleRate / (binCount * 2.);
+
+				for (size_t i = 0; i < mBandEdges.size(); ++i)
+				{
+					mBandStart.push_back(std::min(binCount, (size_t)std::ceil(mBandEdges[i] / binWidth)));
+				}
+
+				mColumnCount = mBandEdges.size() - 1;
+			}
+			else
+			{
+				mColumnCount = binCount;
+			}
+
+			const size_t headerSize = 4 + sizeof(uint32_t) * 5 + sizeof(float) * mColumnCount;
+
+			if (!mFile.openForWriting(mPath, headerSize + sizeof(float) * mColumnCount * frameCount))
+			{
+				return false;
+			}
+
+			char* header = mFile.getData();
+			uint32_t values[] = { 1, (uint32_t)frameCount, (uint32_t)mColumnCount, (uint32_t)sampleRate, (uint32_t)hopSize };
+
+			memcpy(header, "TSPC", 4);
+			memcpy(header + 4, values, sizeof(values));
+
+			float* edges = (float*)(header + 4 + sizeof(values));
+
+			for (size_t i = 0; i < mColumnCount; ++i)
+			{
+				edges[i] = mBandStart.empty() ? 0.f : (float)mBandEdges[i];
+			}
+
+			mRows = (float*)(header + headerSize);
+
+			return true;
+		}
+
+		virtual void consume(size_t frameNumber, const SpectrumBlock& block)
+		{
+			if (frameNumber >= mFrameCount || mRows == NULL)
+			{
+				return;
+			}
+
+			float* row = mRows + frameNumber * mColumnCount;
+
+			if (mBandStart.empty())
+			{
+				for (size_t bin = 0; bin < mColumnCount; ++bin)
+				{
+					row[bin] = (float)block.mData[bin].second;
+				}
+			}
+			else
+			{
+				for (size_t band = 0; band < mColumnCount; ++band)
+				{
+					double sum = 0.;
+					size_t from = mBandStart[band];
+					size_t to = std::max(from + 1, mBandStart[band + 1]);
+
+					for (size_t bin = from; bin < to && bin < mBinCount; ++bin)
+					{
+						sum += block.mData[bin].second * block.mData[bin].second;
+					}
+
+					row[band] = (float)std::sqrt(sum / (to - from));
+				}
+			}
+		}
+
+		virtual void finish()
+		{
+			mRows = NULL;
+			mFile.close();
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(SpectrumFileWriter);
+
+		std::string mPath;
+		std::vector<double> mBandEdges;
+		std::vector<size_t> mBandStart;
+		MappedFile mFile;
+		size_t mFrameCount;
+		size_t mColumnCount;
+		size_t mBinCount;
+		float* mRows;
+	};
+
+	// Runs SpectroCalculator over a whole file on all cores. File is split into chunks aligned to hop boundaries;
+	// each chunk gets its own analyzer which starts earlier by a warm-up period, so by the time chunk output begins
+	// its smoothing state has converged to what a single sequential analyzer would have (residual is 0.01 ^ timeConstants).
+	// Output frames are identical in position and numbering to the live analyzer fed with the same samples.
+	template <typename T> class OfflineSpectroAnalyzer
+	{
+	public:
+		OfflineSpectroAnalyzer(std::pair<double, double> attackRelease, size_t fftSize = 1024)
+			: mAttackRelease(attackRelease), mFftSize(fftSize), mChunkSeconds(10.), mWarmUpTimeConstants(3.)
+		{
+		}
+
+		void setChunkLength(double seconds) { mChunkSeconds = seconds; }
+
+		// Each time constant (the time attack/release takes to reach 1% of target) is -40dB of residual difference from sequential analysis
+		void setWarmUpTimeConstants(double count) { mWarmUpTimeConstants = count; }
+
+		size_t getHopSize() { return mFftSize / 2; }
+
+		bool run(PcmFileView& file, OfflineAnalysisSink& sink, size_t threadCount = 0)
+		{
+			const PcmFormat& format = file.getFormat();
+			const size_t hop = getHopSize();
+			const size_t frameCount = file.getFrameCount() / hop;
+
+			if (frameCount == 0 || !sink.prepare(frameCount, mFftSize / 2, format.mSampleRate, hop))
+			{
+				return false;
+			}
+
+			if (threadCount == 0)
+			{
+				threadCount = std::max(1u, std::thread::hardware_concurrency());
+			}
+
+			size_t hopsPerChunk = std::max((size_t)1, (size_t)(mChunkSeconds * format.mSampleRate / hop));
+			size_t warmUpHops = calculateWarmUpHops(format.mSampleRate);
+
+			// Spectrum hold never forgets, so there is nothing to converge to - whole file has to be one chunk
+			if (warmUpHops == 0)
+			{
+				hopsPerChunk = frameCount;
+				threadCount = 1;
+			}
+
+			const size_t chunkCount = (frameCount + hopsPerChunk - 1) / hopsPerChunk;
+
+			std::atomic<size_t> nextChunk(0);
+			std::vector<std::thread> workers;
+
+			auto worker = [&]()
+			{
+				size_t chunk;
+
+				while ((chunk = nextChunk.fetch_add(1)) < chunkCount)
+				{
+					size_t firstHop = chunk * hopsPerChunk;
+					size_t lastHop = std::min(frameCount, firstHop + hopsPerChunk);
+
+					processChunk(file, sink, firstHop - std::min(firstHop, warmUpHops), firstHop, lastHop);
+				}
+			};
+
+			threadCount = std::min(threadCount, chunkCount);
+
+			for (size_t i = 1; i < threadCount; ++i)
+			{
+				workers.push_back(std::thread(worker));
+			}
+
+			worker();
+
+			for (size_t i = 0; i < workers.size(); ++i)
+			{
+				workers[i].join();
+			}
+
+			sink.finish();
+
+			return true;
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(OfflineSpectroAnalyzer);
+
+		size_t calculateWarmUpHops(size_t sampleRate)
+		{
+			double slowestMs = std::max(mAttackRelease.first, mAttackRelease.second);
+
+			if (slowestMs == std::numeric_limits<double>::infinity())
+			{
+				return 0;
+			}
+
+			// Overlapping buffers need a whole FFT frame before output is the same, smoothing needs the rest
+			double samples = slowestMs * 0.001 * sampleRate * mWarmUpTimeConstants + mFftSize;
+
+			return (size_t)std::ceil(samples / getHopSize());
+		}
+
+		// Frame number n is completed on sample (n + 1) * hop - 1 by an analyzer started at sample 0,
+		// analyzer started at a hop boundary keeps the same phase.
+		void processChunk(PcmFileView& file, OfflineAnalysisSink& sink, size_t startHop, size_t firstHop, size_t lastHop)
+		{
+			const size_t hop = getHopSize();
+			const size_t channelCount = file.getFormat().mChannelCount;
+			const size_t blockFrames = 4096;
+
+			SpectroCalculator<T> calculator(file.getFormat().mSampleRate, mAttackRelease, 0, mFftSize, channelCount);
+			std::vector<T> samples(blockFrames * channelCount);
+
+			size_t position = startHop * hop;
+			const size_t end = lastHop * hop;
+
+			while (position < end)
+			{
+				size_t count = file.readFrames(position, std::min(blockFrames, end - position), &samples[0]);
+
+				if (count == 0)
+				{
+					break;
+				}
+
+				for (size_t i = 0; i < count; ++i)
+				{
+					SpectrumBlock block = calculator.process(&samples[i * channelCount]);
+
+					if (block.mLength > 0)
+					{
+						size_t frameNumber = (position + i + 1) / hop - 1;
+
+						if (frameNumber >= firstHop)
+						{
+							sink.consume(frameNumber, block);
+						}
+					}
+				}
+
+				position += count;
+			}
+		}
+
+		std::pair<double, double> mAttackRelease;
+		size_t mFftSize;
+		double mChunkSeconds;
+		double mWarmUpTimeConstants;
+	};
+
+}}
+
+#endif
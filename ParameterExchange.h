@@ -0,0 +1,61 @@
+#ifndef TOMATL_PARAMETER_EXCHANGE
+#define TOMATL_PARAMETER_EXCHANGE
+
+namespace tomatl { namespace dsp {
+
+// Consistent parameter sets from a control (UI) thread to a processing thread.
+// Writer edits its own copy and publishes it as a whole, reader picks up the latest complete set at a point of its
+// choosing (once per block, per frame, etc.), so it never sees half-updated coefficient pairs. Built on triple_buffer:
+// no locks, no allocation, neither side waits. TParams should be a plain copyable struct.
+//
+// One writer thread and one reader thread, like spsc_queue.
+template <typename TParams> class ParameterExchange
+{
+public:
+	ParameterExchange(const TParams& initial = TParams()) : mLocal(initial), mExchange(initial), mCurrent(initial)
+	{
+	}
+
+	// Writer: replaces the whole set
+	void post(const TParams& params)
+	{
+		mLocal = params;
+		commit();
+	}
+
+	// Writer: edit fields of the last posted set in place, then commit()
+	TParams& edit() { return mLocal; }
+
+	void commit()
+	{
+		mExchange.back() = mLocal;
+		mExchange.publish();
+	}
+
+	// Reader: takes the latest posted set if there is one, returns true if it has changed since the last pickUp()
+	bool pickUp()
+	{
+		if (mExchange.update())
+		{
+			mCurrent = mExchange.front();
+
+			return true;
+		}
+
+		return false;
+	}
+
+	// Reader: set taken by the last pickUp(), doesn't change in between
+	const TParams& current() { return mCurrent; }
+
+private:
+	TOMATL_DECLARE_NON_MOVABLE_COPYABLE(ParameterExchange);
+
+	TParams mLocal;
+	triple_buffer<TParams> mExchange;
+	TParams mCurrent;
+};
+
+}}
+
+#endif
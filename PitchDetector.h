@@ -0,0 +1,283 @@
+#ifndef TOMATL_PITCH_DETECTOR
+#define TOMATL_PITCH_DETECTOR
+
+#include <vector>
+#include <cmath>
+
+namespace tomatl { namespace dsp {
+
+	struct PitchEstimate
+	{
+		PitchEstimate() : mFrequency(0.), mConfidence(0.), mIsVoiced(false), mIndex(0)
+		{
+		}
+
+		double mFrequency;	// Hz, 0 if nothing was found at all
+		double mConfidence;	// 0...1, 1 - (normalized difference at chosen lag)
+		bool mIsVoiced;		// Normalized difference got under threshold, i.e. estimate can be trusted
+		size_t mIndex;		// Number of analysis hops since reset
+		FrequencyDomainGrid::NoteNotation mNote;
+	};
+
+	// YIN fundamental frequency estimator. Difference function d(tau) = E(x[0..W)) + E(x[tau..tau+W)) - 2 * r(tau)
+	// only needs energies (prefix sums) and cross-correlation r(tau) of the first half of the window with the whole window,
+	// and the latter is one complex FFT (both halves packed into real/imaginary parts), a product and inverse FFT,
+	// so estimation is O(N log N) instead of O(N^2).
+	//
+	// Input is taken in arbitrary blocks, new estimate is computed each hop over the latest window.
+	//
+	// Longest period the window can hold is W / 2 - 2 samples, so the lowest detectable frequency is
+	// max(minFrequency, sampleRate / (W / 2 - 2)), see getLowestDetectableFrequency(). Window size of 0 picks the
+	// smallest power of two which covers minFrequency up to maxSampleRate (4096 for defaults).
+	template <typename T> class PitchDetector
+	{
+	public:
+		PitchDetector(size_t windowSize = 0, size_t hopSize = 512, double minFrequency = 40., double maxFrequency = 2000., double maxSampleRate = 48000.)
+			: mWindowSize(windowSize > 0 ? windowSize : getRequiredWindowSize(minFrequency, maxSampleRate)), mHopSize(hopSize),
+			mMaxSampleRate(maxSampleRate), mWritePosition(0), mSamplesSinceHop(0), mSamplesSeen(0)
+		{
+			setThreshold(0.15);
+			setFrequencyRange(minFrequency, maxFrequency);
+
+			mHistory.assign(mWindowSize, 0.);
+			mFrame.assign(mWindowSize, 0.);
+			mFft.assign(mWindowSize * 2, 0.);
+			mEnergy.assign(mWindowSize + 1, 0.);
+			mDifference.assign(mWindowSize / 2, 0.);
+		}
+
+		// Absolute threshold of cumulative mean normalized difference, 0.1-0.2 is typical
+		void setThreshold(double value) { mThreshold = value; }
+
+		// Returns false if the window is too short for minFrequency at maxSampleRate given to constructor: the range is
+		// still set, but periods longer than the window allows are not searched.
+		bool setFrequencyRange(double minFrequency, double maxFrequency)
+		{
+			mMinFrequency = std::min(minFrequency, maxFrequency);
+			mMaxFrequency = std::max(minFrequency, maxFrequency);
+
+			return getLowestDetectableFrequency(mMaxSampleRate) <= mMinFrequency;
+		}
+
+		double getLowestDetectableFrequency(double sampleRate)
+		{
+			return std::max(mMinFrequency, sampleRate / (mWindowSize / 2 - 2));
+		}
+
+		size_t getWindowSize() { return mWindowSize; }
+
+		// Smallest power of two window whose longest searchable period covers minFrequency at sampleRate
+		static size_t getRequiredWindowSize(double minFrequency, double sampleRate)
+		{
+			size_t maxLag = (size_t)std::ceil(sampleRate / minFrequency);
+			size_t result = 64;
+
+			while (result / 2 - 2 < maxLag)
+			{
+				result *= 2;
+			}
+
+			return result;
+		}
+
+		void reset()
+		{
+			std::fill(mHistory.begin(), mHistory.end(), 0.);
+			mWritePosition = 0;
+			mSamplesSinceHop = 0;
+			mSamplesSeen = 0;
+			mLastEstimate = PitchEstimate();
+		}
+
+		// Returns true if at least one new estimate was made during this block
+		bool process(const T* samples, size_t count, double sampleRate)
+		{
+			TOMATL_RT_SCOPE();
+
+			bool updated = false;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				mHistory[mWritePosition] = samples[i];
+				mWritePosition = (mWritePosition + 1) % mWindowSize;
+
+				++mSamplesSinceHop;
+				++mSamplesSeen;
+
+				if (mSamplesSinceHop >= mHopSize && mSamplesSeen >= mWindowSize)
+				{
+					mSamplesSinceHop = 0;
+					estimate(sampleRate);
+					updated = true;
+				}
+			}
+
+			return updated;
+		}
+
+		const PitchEstimate& getLastEstimate() { return mLastEstimate; }
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(PitchDetector);
+
+		void estimate(double sampleRate)
+		{
+			const size_t n = mWindowSize;
+			const size_t half = n / 2;
+
+			// Oldest sample first
+			for (size_t i = 0; i < n; ++i)
+			{
+				mFrame[i] = mHistory[(mWritePosition + i) % n];
+			}
+
+			mEnergy[0] = 0.;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				mEnergy[i + 1] = mEnergy[i] + mFrame[i] * mFrame[i];
+			}
+
+			calculateCorrelation();
+
+			// d(tau) over integration window of half frame
+			mDifference[0] = 0.;
+
+			for (size_t tau = 1; tau < half; ++tau)
+			{
+				double crossTerm = mFft[tau * 2];
+				double value = mEnergy[half] + (mEnergy[tau + half] - mEnergy[tau]) - 2. * crossTerm;
+
+				mDifference[tau] = std::max(0., value);
+			}
+
+			// Cumulative mean normalization, d'(tau) = d(tau) * tau / sum(d(1..tau))
+			double runningSum = 0.;
+			mDifference[0] = 1.;
+
+			for (size_t tau = 1; tau < half; ++tau)
+			{
+				runningSum += mDifference[tau];
+				mDifference[tau] = runningSum > 0. ? mDifference[tau] * tau / runningSum : 1.;
+			}
+
+			size_t minLag = std::max((size_t)2, (size_t)(sampleRate / mMaxFrequency));
+			size_t maxLag = std::min(half - 2, (size_t)std::ceil(sampleRate / mMinFrequency));
+
+			PitchEstimate result;
+			result.mIndex = mLastEstimate.mIndex + 1;
+
+			if (minLag >= maxLag)
+			{
+				mLastEstimate = result;
+				return;
+			}
+
+			size_t best = 0;
+
+			// First dip under threshold, followed down to its local minimum
+			for (size_t tau = minLag; tau <= maxLag; ++tau)
+			{
+				if (mDifference[tau] < mThreshold)
+				{
+					while (tau + 1 <= maxLag && mDifference[tau + 1] < mDifference[tau])
+					{
+						++tau;
+					}
+
+					best = tau;
+					result.mIsVoiced = true;
+					break;
+				}
+			}
+
+			// Nothing is periodic enough - report the best guess with its (low) confidence
+			if (best == 0)
+			{
+				best = minLag;
+
+				for (size_t tau = minLag + 1; tau <= maxLag; ++tau)
+				{
+					if (mDifference[tau] < mDifference[best])
+					{
+						best = tau;
+					}
+				}
+			}
+
+			// Parabolic interpolation of the minimum
+			double alpha = mDifference[best - 1];
+			double beta = mDifference[best];
+			double gamma = mDifference[best + 1];
+			double denominator = alpha - 2. * beta + gamma;
+			double offset = denominator > 0. ? TOMATL_BOUND_VALUE(0.5 * (alpha - gamma) / denominator, -0.5, 0.5) : 0.;
+
+			result.mFrequency = sampleRate / (best + offset);
+			result.mConfidence = TOMATL_BOUND_VALUE(1. - beta, 0., 1.);
+			result.mNote = FrequencyDomainGrid::NoteNotation::fromFrequency(result.mFrequency);
+
+			mLastEstimate = result;
+		}
+
+		// Leaves r(tau) = sum(x[j] * x[j + tau], j < W/2) in real parts of mFft. First half is zero-padded to full window,
+		// so for tau < W/2 circular correlation doesn't wrap around.
+		void calculateCorrelation()
+		{
+			const size_t n = mWindowSize;
+			const size_t half = n / 2;
+			T* z = &mFft[0];
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				z[i * 2] = mFrame[i];
+				z[i * 2 + 1] = i < half ? mFrame[i] : 0.;
+			}
+
+			FftCalculator<T>::calculateFast(z, n);
+
+			// A = spectrum of full frame (real part), B = spectrum of first half (imaginary part).
+			// conj(B[k]) * A[k] is Hermitian, as both are spectra of real signals, so it's enough to compute k <= N/2.
+			for (size_t k = 0; k <= half; ++k)
+			{
+				size_t mirrored = (n - k) % n;
+
+				T zkRe = z[k * 2], zkIm = z[k * 2 + 1];
+				T zmRe = z[mirrored * 2], zmIm = z[mirrored * 2 + 1];
+
+				T aRe = 0.5 * (zkRe + zmRe);
+				T aIm = 0.5 * (zkIm - zmIm);
+				T bRe = 0.5 * (zkIm + zmIm);
+				T bIm = 0.5 * (zmRe - zkRe);
+
+				T pRe = (bRe * aRe + bIm * aIm) / n;
+				T pIm = (bRe * aIm - bIm * aRe) / n;
+
+				z[k * 2] = pRe;
+				z[k * 2 + 1] = pIm;
+				z[mirrored * 2] = pRe;
+				z[mirrored * 2 + 1] = -pIm;
+			}
+
+			FftCalculator<T>::calculateFast(z, n, true);
+		}
+
+		size_t mWindowSize;
+		size_t mHopSize;
+		double mMaxSampleRate;
+		double mMinFrequency;
+		double mMaxFrequency;
+		double mThreshold;
+		size_t mWritePosition;
+		size_t mSamplesSinceHop;
+		size_t mSamplesSeen;
+		std::vector<T> mHistory;
+		std::vector<T> mFrame;
+		std::vector<T> mFft;
+		std::vector<double> mEnergy;
+		std::vector<double> mDifference;
+		PitchEstimate mLastEstimate;
+	};
+
+}}
+
+#endif
@@ -0,0 +1,217 @@
+#ifndef TOMATL_PROFILER
+#define TOMATL_PROFILER
+
+#include <cstdint>
+
+#ifdef TOMATL_ENABLE_PROFILING
+	#include <atomic>
+	#include <chrono>
+	#include <cmath>
+	#include <algorithm>
+
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#elif defined(__x86_64__) || defined(__i386__)
+		#include <x86intrin.h>
+	#endif
+#endif
+
+namespace tomatl { namespace dsp {
+
+	// Percentiles are resolved to log2 buckets, so they're accurate within a factor of sqrt(2)
+	struct ProfileSnapshot
+	{
+		ProfileSnapshot() : mCount(0), mP50(0.), mP99(0.), mMax(0.), mMean(0.)
+		{
+		}
+
+		uint64_t mCount;
+		double mP50;	// Cycles (or nanoseconds on platforms without cycle counter)
+		double mP99;
+		double mMax;
+		double mMean;
+	};
+
+#ifdef TOMATL_ENABLE_PROFILING
+
+	// TSC on x86, steady clock nanoseconds elsewhere
+	static forcedinline uint64_t readCycleCounter()
+	{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+	// Histogram of durations with one bucket per power of two. Written by one thread at a time (whichever runs the
+	// owning component), so plain load/store pairs are enough and recording never does locked read-modify-write.
+	// Readers on other threads may see a histogram one sample behind, never a torn counter.
+	class StageHistogram
+	{
+	public:
+		StageHistogram() : mTotal(0), mMax(0)
+		{
+			for (int i = 0; i < cBucketCount; ++i)
+			{
+				mBuckets[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		forcedinline void record(uint64_t value)
+		{
+			std::atomic<uint64_t>& bucket = mBuckets[bucketIndex(value)];
+
+			bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			mTotal.store(mTotal.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+
+			if (value > mMax.load(std::memory_order_relaxed))
+			{
+				mMax.store(value, std::memory_order_relaxed);
+			}
+		}
+
+		ProfileSnapshot getSnapshot() const
+		{
+			ProfileSnapshot result;
+			uint64_t counts[cBucketCount];
+
+			for (int i = 0; i < cBucketCount; ++i)
+			{
+				counts[i] = mBuckets[i].load(std::memory_order_relaxed);
+				result.mCount += counts[i];
+			}
+
+			if (result.mCount == 0)
+			{
+				return result;
+			}
+
+			result.mMax = (double)mMax.load(std::memory_order_relaxed);
+			result.mMean = (double)mTotal.load(std::memory_order_relaxed) / result.mCount;
+			result.mP50 = std::min(result.mMax, percentile(counts, result.mCount, 0.5));
+			result.mP99 = std::min(result.mMax, percentile(counts, result.mCount, 0.99));
+
+			return result;
+		}
+
+		// Not synchronized with record(), meant for occasional use from the owning thread
+		void reset()
+		{
+			for (int i = 0; i < cBucketCount; ++i)
+			{
+				mBuckets[i].store(0, std::memory_order_relaxed);
+			}
+
+			mTotal.store(0, std::memory_order_relaxed);
+			mMax.store(0, std::memory_order_relaxed);
+		}
+
+	private:
+		static const int cBucketCount = 64;
+
+		static forcedinline int bucketIndex(uint64_t value)
+		{
+			if (value == 0)
+			{
+				return 0;
+			}
+#if defined(__GNUC__)
+			return 63 - __builtin_clzll(value);
+#else
+			int index = 0;
+
+			while (value >>= 1)
+			{
+				++index;
+			}
+
+			return index;
+#endif
+		}
+
+		// Geometric middle of the bucket which contains requested fraction
+		static double percentile(const uint64_t* counts, uint64_t total, double fraction)
+		{
+			uint64_t target = (uint64_t)std::ceil(total * fraction);
+			uint64_t accumulated = 0;
+
+			for (int i = 0; i < cBucketCount; ++i)
+			{
+				accumulated += counts[i];
+
+				if (accumulated >= target)
+				{
+					return std::pow(2., i + 0.5);
+				}
+			}
+
+			return std::pow(2., cBucketCount);
+		}
+
+		std::atomic<uint64_t> mBuckets[cBucketCount];
+		std::atomic<uint64_t> mTotal;
+		std::atomic<uint64_t> mMax;
+	};
+
+	// Set of stage histograms owned by one component instance. Stages are usually measured as laps:
+	// start() at the beginning of a hot path, then lap(stage) after each stage.
+	template <size_t TStageCount> class StageProfiler
+	{
+	public:
+		StageProfiler() : mLapStart(0)
+		{
+		}
+
+		forcedinline void start()
+		{
+			mLapStart = readCycleCounter();
+		}
+
+		forcedinline void lap(size_t stage)
+		{
+			uint64_t now = readCycleCounter();
+
+			mStages[stage].record(now - mLapStart);
+			mLapStart = now;
+		}
+
+		ProfileSnapshot getSnapshot(size_t stage) const
+		{
+			return mStages[stage].getSnapshot();
+		}
+
+		void reset()
+		{
+			for (size_t i = 0; i < TStageCount; ++i)
+			{
+				mStages[i].reset();
+			}
+		}
+
+	private:
+		StageHistogram mStages[TStageCount];
+		uint64_t mLapStart;
+	};
+
+	#define TOMATL_PROFILE_START(profiler) (profiler).start()
+	#define TOMATL_PROFILE_LAP(profiler, stage) (profiler).lap(stage)
+
+#else
+
+	// Profiling is compiled out: no members, no clock reads, snapshots are empty
+	template <size_t TStageCount> class StageProfiler
+	{
+	public:
+		ProfileSnapshot getSnapshot(size_t) const { return ProfileSnapshot(); }
+		void reset() {}
+	};
+
+	#define TOMATL_PROFILE_START(profiler)
+	#define TOMATL_PROFILE_LAP(profiler, stage)
+
+#endif
+
+}}
+
+#endif
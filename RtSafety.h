@@ -0,0 +1,420 @@
+#ifndef TOMATL_RT_SAFETY
+#define TOMATL_RT_SAFETY
+
+// Debug/test mode which traps memory allocation and mutex locking inside code marked as realtime.
+//
+// Define TOMATL_RT_SAFETY_CHECKS for the whole build to enable it, and additionally TOMATL_RT_SAFETY_IMPLEMENTATION in
+// exactly one translation unit (before including dsp-utility.h): that one gets replacement global operator new/delete,
+// (including C++17 aligned ones), and on glibc also malloc/calloc/realloc/free, memalign/aligned_alloc/posix_memalign
+// and pthread_mutex_lock wrappers (std::mutex ends up there too). On other platforms only operator new/delete are intercepted.
+//
+// Process paths are marked with TOMATL_RT_SCOPE(), scopes nest and are tracked per thread. A violation prints what
+// happened and the stack to stderr and calls the violation handler, which aborts by default, so tests fail loudly.
+// Without TOMATL_RT_SAFETY_CHECKS the macros expand to nothing.
+
+#ifdef TOMATL_RT_SAFETY_CHECKS
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+	#include <execinfo.h>
+	#define TOMATL_RT_SAFETY_HAS_BACKTRACE
+#endif
+
+namespace tomatl { namespace dsp {
+
+	class RtSafety
+	{
+	public:
+		typedef void (*ViolationHandler)(const char* what, const char* scope);
+
+		static forcedinline bool isRealtime()
+		{
+			const ThreadState& s = state();
+
+			return s.mDepth > 0 && s.mAllowDepth == 0;
+		}
+
+		static forcedinline void enter(const char* scope)
+		{
+			ThreadState& s = state();
+
+			if (s.mDepth++ == 0)
+			{
+				s.mScope = scope;
+			}
+		}
+
+		static forcedinline void exit()
+		{
+			--state().mDepth;
+		}
+
+		static forcedinline void allow(bool value)
+		{
+			state().mAllowDepth += value ? 1 : -1;
+		}
+
+		// Called by interceptors. Cheap when not in realtime scope: one thread-local read.
+		static forcedinline void check(const char* what)
+		{
+			ThreadState& s = state();
+
+			if (s.mDepth > 0 && s.mAllowDepth == 0 && !s.mReporting)
+			{
+				report(what, s);
+			}
+		}
+
+		// NULL restores default (abort)
+		static void setViolationHandler(ViolationHandler handler)
+		{
+			handlerStorage().store(handler);
+		}
+
+		static size_t getViolationCount()
+		{
+			return violationCounter().load();
+		}
+
+	private:
+		RtSafety(){}
+
+		struct ThreadState
+		{
+			int mDepth;
+			int mAllowDepth;
+			bool mReporting;
+			const char* mScope;
+		};
+
+		static forcedinline ThreadState& state()
+		{
+			static thread_local ThreadState s = { 0, 0, false, NULL };
+
+			return s;
+		}
+
+		static std::atomic<ViolationHandler>& handlerStorage()
+		{
+			static std::atomic<ViolationHandler> handler(NULL);
+
+			return handler;
+		}
+
+		static std::atomic<size_t>& violationCounter()
+		{
+			static std::atomic<size_t> counter(0);
+
+			return counter;
+		}
+
+		// Reporting itself may allocate (backtrace, stdio), so checks are suspended while it runs
+		static void report(const char* what, ThreadState& s)
+		{
+			s.mReporting = true;
+			++violationCounter();
+
+			fprintf(stderr, "RT safety violation: %s inside realtime scope %s\n", what, s.mScope != NULL ? s.mScope : "?");
+
+#ifdef TOMATL_RT_SAFETY_HAS_BACKTRACE
+			void* frames[64];
+			int count = backtrace(frames, 64);
+			backtrace_symbols_fd(frames, count, 2);
+#endif
+
+			fflush(stderr);
+
+			ViolationHandler handler = handlerStorage().load();
+
+			if (handler != NULL)
+			{
+				handler(what, s.mScope);
+			}
+			else
+			{
+				abort();
+			}
+
+			s.mReporting = false;
+		}
+	};
+
+	class RtScope
+	{
+	public:
+		forcedinline RtScope(const char* name) { RtSafety::enter(name); }
+		forcedinline ~RtScope() { RtSafety::exit(); }
+	};
+
+	// Suspends checking for deliberate exceptions inside a realtime scope
+	class RtAllowScope
+	{
+	public:
+		forcedinline RtAllowScope() { RtSafety::allow(true); }
+		forcedinline ~RtAllowScope() { RtSafety::allow(false); }
+	};
+
+}}
+
+#define TOMATL_RT_SCOPE() tomatl::dsp::RtScope tomatlRtScope(__FUNCTION__)
+#define TOMATL_RT_ALLOW() tomatl::dsp::RtAllowScope tomatlRtAllowScope
+
+#ifdef TOMATL_RT_SAFETY_IMPLEMENTATION
+
+#include <new>
+#include <cerrno>
+
+#ifdef __GLIBC__
+	#include <dlfcn.h>
+	#include <pthread.h>
+
+	extern "C" void* __libc_malloc(size_t size);
+	extern "C" void* __libc_calloc(size_t count, size_t size);
+	extern "C" void* __libc_realloc(void* pointer, size_t size);
+	extern "C" void* __libc_memalign(size_t alignment, size_t size);
+	extern "C" void __libc_free(void* pointer);
+
+	#define TOMATL_RT_RAW_MALLOC __libc_malloc
+	#define TOMATL_RT_RAW_FREE __libc_free
+	#define TOMATL_RT_RAW_ALIGNED_MALLOC(size, alignment) __libc_memalign(alignment, size)
+	#define TOMATL_RT_RAW_ALIGNED_FREE __libc_free
+
+	extern "C" void* malloc(size_t size)
+	{
+		tomatl::dsp::RtSafety::check("malloc");
+		return __libc_malloc(size);
+	}
+
+	extern "C" void* calloc(size_t count, size_t size)
+	{
+		tomatl::dsp::RtSafety::check("calloc");
+		return __libc_calloc(count, size);
+	}
+
+	extern "C" void* realloc(void* pointer, size_t size)
+	{
+		tomatl::dsp::RtSafety::check("realloc");
+		return __libc_realloc(pointer, size);
+	}
+
+	extern "C" void free(void* pointer)
+	{
+		if (pointer != NULL)
+		{
+			tomatl::dsp::RtSafety::check("free");
+		}
+
+		__libc_free(pointer);
+	}
+
+	// aligned_alloc is a separate (weak) symbol in glibc, wrapping memalign alone doesn't catch it
+	extern "C" void* memalign(size_t alignment, size_t size)
+	{
+		tomatl::dsp::RtSafety::check("memalign");
+		return __libc_memalign(alignment, size);
+	}
+
+	extern "C" void* aligned_alloc(size_t alignment, size_t size)
+	{
+		tomatl::dsp::RtSafety::check("aligned_alloc");
+		return __libc_memalign(alignment, size);
+	}
+
+	extern "C" int posix_memalign(void** result, size_t alignment, size_t size)
+	{
+		tomatl::dsp::RtSafety::check("posix_memalign");
+
+		if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+		{
+			return EINVAL;
+		}
+
+		void* pointer = __libc_memalign(alignment, size);
+
+		if (pointer == NULL)
+		{
+			return ENOMEM;
+		}
+
+		*result = pointer;
+
+		return 0;
+	}
+
+	namespace tomatl { namespace dsp {
+
+		typedef int (*PthreadMutexLock)(pthread_mutex_t*);
+
+		// Resolved during static initialization, before any realtime scope can be entered
+		static PthreadMutexLock sRealPthreadMutexLock = (PthreadMutexLock)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+
+	}}
+
+	extern "C" int pthread_mutex_lock(pthread_mutex_t* mutex)
+	{
+		tomatl::dsp::RtSafety::check("pthread_mutex_lock");
+
+		if (tomatl::dsp::sRealPthreadMutexLock == NULL)
+		{
+			tomatl::dsp::sRealPthreadMutexLock = (tomatl::dsp::PthreadMutexLock)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+		}
+
+		return tomatl::dsp::sRealPthreadMutexLock(mutex);
+	}
+#elif defined(_MSC_VER)
+	#include <malloc.h>
+
+	#define TOMATL_RT_RAW_MALLOC std::malloc
+	#define TOMATL_RT_RAW_FREE std::free
+	#define TOMATL_RT_RAW_ALIGNED_MALLOC(size, alignment) _aligned_malloc(size, alignment)
+	#define TOMATL_RT_RAW_ALIGNED_FREE _aligned_free
+#else
+	#include <stdlib.h>
+
+	namespace tomatl { namespace dsp {
+
+		static void* rtPosixAlignedMalloc(size_t size, size_t alignment)
+		{
+			void* result = NULL;
+
+			return posix_memalign(&result, alignment < sizeof(void*) ? sizeof(void*) : alignment, size) == 0 ? result : NULL;
+		}
+
+	}}
+
+	#define TOMATL_RT_RAW_MALLOC std::malloc
+	#define TOMATL_RT_RAW_FREE std::free
+	#define TOMATL_RT_RAW_ALIGNED_MALLOC(size, alignment) tomatl::dsp::rtPosixAlignedMalloc(size, alignment)
+	#define TOMATL_RT_RAW_ALIGNED_FREE std::free
+#endif
+
+namespace tomatl { namespace dsp {
+
+	static void* rtCheckedAllocate(size_t size, const char* what)
+	{
+		RtSafety::check(what);
+
+		return TOMATL_RT_RAW_MALLOC(size == 0 ? 1 : size);
+	}
+
+	static void rtCheckedFree(void* pointer, const char* what)
+	{
+		if (pointer != NULL)
+		{
+			RtSafety::check(what);
+		}
+
+		TOMATL_RT_RAW_FREE(pointer);
+	}
+
+	static void* rtCheckedAlignedAllocate(size_t size, size_t alignment, const char* what)
+	{
+		RtSafety::check(what);
+
+		return TOMATL_RT_RAW_ALIGNED_MALLOC(size == 0 ? 1 : size, alignment);
+	}
+
+	static void rtCheckedAlignedFree(void* pointer, const char* what)
+	{
+		if (pointer != NULL)
+		{
+			RtSafety::check(what);
+		}
+
+		TOMATL_RT_RAW_ALIGNED_FREE(pointer);
+	}
+
+#ifdef TOMATL_RT_SAFETY_HAS_BACKTRACE
+	// First backtrace() call loads unwinder library, which allocates - better do it now than during the first report
+	static int sBacktraceWarmUp = []() { void* frame[1]; return backtrace(frame, 1); }();
+#endif
+
+}}
+
+void* operator new(size_t size)
+{
+	void* result = tomatl::dsp::rtCheckedAllocate(size, "operator new");
+
+	if (result == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void* operator new[](size_t size)
+{
+	void* result = tomatl::dsp::rtCheckedAllocate(size, "operator new[]");
+
+	if (result == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return tomatl::dsp::rtCheckedAllocate(size, "operator new"); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return tomatl::dsp::rtCheckedAllocate(size, "operator new[]"); }
+void operator delete(void* pointer) noexcept { tomatl::dsp::rtCheckedFree(pointer, "operator delete"); }
+void operator delete[](void* pointer) noexcept { tomatl::dsp::rtCheckedFree(pointer, "operator delete[]"); }
+void operator delete(void* pointer, size_t) noexcept { tomatl::dsp::rtCheckedFree(pointer, "operator delete"); }
+void operator delete[](void* pointer, size_t) noexcept { tomatl::dsp::rtCheckedFree(pointer, "operator delete[]"); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { tomatl::dsp::rtCheckedFree(pointer, "operator delete"); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { tomatl::dsp::rtCheckedFree(pointer, "operator delete[]"); }
+
+#ifdef __cpp_aligned_new
+// Over-aligned types (alignas above the default new alignment) come through these
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	void* result = tomatl::dsp::rtCheckedAlignedAllocate(size, (size_t)alignment, "operator new");
+
+	if (result == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	void* result = tomatl::dsp::rtCheckedAlignedAllocate(size, (size_t)alignment, "operator new[]");
+
+	if (result == NULL)
+	{
+		throw std::bad_alloc();
+	}
+
+	return result;
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return tomatl::dsp::rtCheckedAlignedAllocate(size, (size_t)alignment, "operator new"); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return tomatl::dsp::rtCheckedAlignedAllocate(size, (size_t)alignment, "operator new[]"); }
+void operator delete(void* pointer, std::align_val_t) noexcept { tomatl::dsp::rtCheckedAlignedFree(pointer, "operator delete"); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { tomatl::dsp::rtCheckedAlignedFree(pointer, "operator delete[]"); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { tomatl::dsp::rtCheckedAlignedFree(pointer, "operator delete"); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { tomatl::dsp::rtCheckedAlignedFree(pointer, "operator delete[]"); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { tomatl::dsp::rtCheckedAlignedFree(pointer, "operator delete"); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { tomatl::dsp::rtCheckedAlignedFree(pointer, "operator delete[]"); }
+#endif
+
+#undef TOMATL_RT_RAW_MALLOC
+#undef TOMATL_RT_RAW_FREE
+#undef TOMATL_RT_RAW_ALIGNED_MALLOC
+#undef TOMATL_RT_RAW_ALIGNED_FREE
+
+#endif // TOMATL_RT_SAFETY_IMPLEMENTATION
+
+#else
+
+#define TOMATL_RT_SCOPE()
+#define TOMATL_RT_ALLOW()
+
+#endif // TOMATL_RT_SAFETY_CHECKS
+
+#endif
@@ -1,6 +1,10 @@
 #ifndef TOMATL_SCALING
 #define TOMATL_SCALING
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
 namespace tomatl { namespace dsp {
 
 template <typename T> struct SingleBound
@@ -44,8 +48,10 @@ template <typename T> struct Bound2D
 template <typename T> class IScale
 {
 public:
-	virtual int scale(int length, SingleBound<T> bound, T val, bool limit = false) = 0;
-	virtual double unscale(int length, SingleBound<T> bound, int val, bool limit = false) = 0;
+	virtual int scale(int length, const SingleBound<T>& bound, T val, bool limit = false) = 0;
+	virtual double unscale(int length, const SingleBound<T>& bound, int val, bool limit = false) = 0;
+
+	virtual ~IScale() {}
 	
 	static T doLimitValue(T value, T min, T max)
 	{
@@ -67,42 +73,103 @@ public:
 	{
 		return std::log(x) / std::log(base);
 	}
+
+protected:
+	IScale() : mPreparedLength(-1), mPreparedBound(0, 0)
+	{
+	}
+
+	// Concrete scales keep constants derived from length and bounds, this tells whether they're stale
+	forcedinline bool needsPreparing(int length, const SingleBound<T>& bound)
+	{
+		if (length != mPreparedLength || bound.mLow != mPreparedBound.mLow || bound.mHigh != mPreparedBound.mHigh)
+		{
+			mPreparedLength = length;
+			mPreparedBound = bound;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	int mPreparedLength;
+	SingleBound<T> mPreparedBound;
 };
 
+// Virtual scale()/unscale() are kept for compatibility, they recalculate constants only when length or bounds change.
+// Hot loops should call prepare() once and then use non-virtual scalePrepared()/scaleN(), or use FixedScale.
+
 class LogScale : public IScale<double>
 {
 public: 
 	LogScale() { }
 
-	int scale(int length, SingleBound<double> bound, double val, bool limit = false)
+	forcedinline void prepare(int length, const SingleBound<double>& bound)
 	{
-		if (limit)
+		if (needsPreparing(length, bound))
 		{
-			val = doLimitValue(val, bound.mLow, bound.mHigh);
-		}
+			double range = std::abs(bound.mHigh - bound.mLow);
 
-		double range = std::abs(bound.mHigh - bound.mLow);
-
-		double expBase = std::pow(range, (1.0 / (double)length));
-		
-		return (int)round(log(val - bound.mLow + 1, expBase));
+			mExpBase = std::pow(range, (1.0 / (double)length));
+			mLogExpBase = std::log(mExpBase);
+		}
 	}
 
-	double unscale(int length, SingleBound<double> bound, int val, bool limit = false)
+	forcedinline int scalePrepared(double val, bool limit = false)
 	{
-		double range = std::abs(bound.mHigh - bound.mLow);
+		if (limit)
+		{
+			val = std::min(mPreparedBound.mHigh, std::max(val, mPreparedBound.mLow));
+		}
 
-		double expBase = std::pow(range, (1.0 / (double)length));
+		return (int)std::round(std::log(val - mPreparedBound.mLow + 1) / mLogExpBase);
+	}
 
-		double value = std::pow(expBase, ((double)val)) + bound.mLow - 1;
+	forcedinline double unscalePrepared(int val, bool limit = false)
+	{
+		double value = std::pow(mExpBase, ((double)val)) + mPreparedBound.mLow - 1;
 
 		if (limit)
 		{
-			value = doLimitValue(value, bound.mLow, bound.mHigh);
+			value = doLimitValue(value, mPreparedBound.mLow, mPreparedBound.mHigh);
 		}
 
 		return value;
 	}
+
+	void scaleN(const double* values, int* result, size_t count, bool limit = false)
+	{
+		const double low = mPreparedBound.mLow;
+		const double high = limit ? mPreparedBound.mHigh : std::numeric_limits<double>::max();
+		const double minimum = limit ? low : -std::numeric_limits<double>::max();
+		const double factor = 1. / mLogExpBase;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			double val = std::min(high, std::max(values[i], minimum));
+
+			result[i] = (int)std::round(std::log(val - low + 1) * factor);
+		}
+	}
+
+	int scale(int length, const SingleBound<double>& bound, double val, bool limit = false)
+	{
+		prepare(length, bound);
+
+		return scalePrepared(val, limit);
+	}
+
+	double unscale(int length, const SingleBound<double>& bound, int val, bool limit = false)
+	{
+		prepare(length, bound);
+
+		return unscalePrepared(val, limit);
+	}
+
+private:
+	double mExpBase;
+	double mLogExpBase;
 };
 
 class OctaveScale : public IScale<double>
@@ -110,35 +177,74 @@ class OctaveScale : public IScale<double>
 public:
 	OctaveScale() { }
 
-	virtual int scale(int length, SingleBound<double> bound, double val, bool limit = false)
+	forcedinline void prepare(int length, const SingleBound<double>& bound)
+	{
+		if (needsPreparing(length, bound))
+		{
+			double octaveCount = std::log2(bound.mHigh) - std::log2(bound.mLow);
+
+			mPixelPerOctave = length / octaveCount;
+			mOffset = std::round(std::log2(bound.mLow / mPixelPerOctave) * mPixelPerOctave);
+			
+			// log2(val / ppo) * ppo - offset == log2(val) * ppo - (log2(ppo) * ppo + offset)
+			mLogOffset = std::log2(mPixelPerOctave) * mPixelPerOctave + mOffset;
+		}
+	}
+
+	forcedinline int scalePrepared(double val, bool limit = false)
 	{
 		if (limit)
 		{
-			val = doLimitValue(val, bound.mLow, bound.mHigh);
+			val = std::min(mPreparedBound.mHigh, std::max(val, mPreparedBound.mLow));
 		}
 
-		double octaveCount = std::log2(bound.mHigh) - std::log2(bound.mLow);
-		double pixelPerOctave = length / octaveCount;
-		double offset = std::round(std::log2(bound.mLow / pixelPerOctave) * pixelPerOctave);
-		
-		return (int)std::round(std::log2(val / pixelPerOctave) * pixelPerOctave - offset);
+		return (int)std::round(std::log2(val) * mPixelPerOctave - mLogOffset);
 	}
 
-	virtual double unscale(int length, SingleBound<double> bound, int val, bool limit = false)
+	forcedinline double unscalePrepared(int val, bool limit = false)
 	{
-		double octaveCount = std::log2(bound.mHigh) - std::log2(bound.mLow);
-		double pixelPerOctave = length / octaveCount;
-		double offset = std::round(std::log2(bound.mLow / pixelPerOctave) * pixelPerOctave);
-
-		double value = pixelPerOctave * std::pow(2., ((val + offset) / pixelPerOctave));
+		double value = mPixelPerOctave * std::pow(2., ((val + mOffset) / mPixelPerOctave));
 
 		if (limit)
 		{
-			value = doLimitValue(value, bound.mLow, bound.mHigh);
+			value = doLimitValue(value, mPreparedBound.mLow, mPreparedBound.mHigh);
 		}
 
 		return value;
 	}
+
+	// Branch-free loop body (one log2, one multiply-subtract), so compiler can vectorize it
+	void scaleN(const double* values, int* result, size_t count, bool limit = false)
+	{
+		const double high = limit ? mPreparedBound.mHigh : std::numeric_limits<double>::max();
+		const double low = limit ? mPreparedBound.mLow : -std::numeric_limits<double>::max();
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			double val = std::min(high, std::max(values[i], low));
+
+			result[i] = (int)std::round(std::log2(val) * mPixelPerOctave - mLogOffset);
+		}
+	}
+
+	virtual int scale(int length, const SingleBound<double>& bound, double val, bool limit = false)
+	{
+		prepare(length, bound);
+
+		return scalePrepared(val, limit);
+	}
+
+	virtual double unscale(int length, const SingleBound<double>& bound, int val, bool limit = false)
+	{
+		prepare(length, bound);
+
+		return unscalePrepared(val, limit);
+	}
+
+private:
+	double mPixelPerOctave;
+	double mOffset;
+	double mLogOffset;
 };
 
 class LinearScale : public IScale<double>
@@ -146,38 +252,116 @@ class LinearScale : public IScale<double>
 public:
 	LinearScale() { }
 
-	int scale(int length, SingleBound<double> bound, double val, bool limit = false)
+	forcedinline void prepare(int length, const SingleBound<double>& bound)
 	{
-		if (limit)
+		if (needsPreparing(length, bound))
 		{
-			val = doLimitValue(val, bound.mLow, bound.mHigh);
+			mIncrement = std::abs(bound.mHigh - bound.mLow) / ((double)length);
 		}
+	}
 
-		double increment = std::abs(bound.mHigh - bound.mLow) / ((double)length);
+	forcedinline int scalePrepared(double val, bool limit = false)
+	{
+		if (limit)
+		{
+			val = std::min(mPreparedBound.mHigh, std::max(val, mPreparedBound.mLow));
+		}
 
-		int result = (int)std::round((val - bound.mLow) / increment);
+		int result = (int)std::round((val - mPreparedBound.mLow) / mIncrement);
 
 		if (limit)
 		{
-			result = doLimitValue(result, 0, length);
+			result = std::min(mPreparedLength, std::max(result, 0));
 		}
 
 		return result;
 	}
 
-	double unscale(int length, SingleBound<double> bound, int val, bool limit = false)
+	forcedinline double unscalePrepared(int val, bool limit = false)
 	{
-		double increment = std::abs(bound.mHigh - bound.mLow) / ((double)length);
-
-		double value = increment * ((double)val) + bound.mLow;
+		double value = mIncrement * ((double)val) + mPreparedBound.mLow;
 
 		if (limit)
 		{
-			value = doLimitValue(value, bound.mLow, bound.mHigh);
+			value = doLimitValue(value, mPreparedBound.mLow, mPreparedBound.mHigh);
 		}
 
 		return value;
 	}
+
+	void scaleN(const double* values, int* result, size_t count, bool limit = false)
+	{
+		const double low = mPreparedBound.mLow;
+		const double high = limit ? mPreparedBound.mHigh : std::numeric_limits<double>::max();
+		const double minimum = limit ? low : -std::numeric_limits<double>::max();
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			double val = std::min(high, std::max(values[i], minimum));
+
+			result[i] = (int)std::round((val - low) / mIncrement);
+		}
+
+		if (limit)
+		{
+			for (size_t i = 0; i < count; ++i)
+			{
+				result[i] = std::min(mPreparedLength, std::max(result[i], 0));
+			}
+		}
+	}
+
+	int scale(int length, const SingleBound<double>& bound, double val, bool limit = false)
+	{
+		prepare(length, bound);
+
+		return scalePrepared(val, limit);
+	}
+
+	double unscale(int length, const SingleBound<double>& bound, int val, bool limit = false)
+	{
+		prepare(length, bound);
+
+		return unscalePrepared(val, limit);
+	}
+
+private:
+	double mIncrement;
+};
+
+// Static dispatch variant: scale type is a template parameter and length/bounds are set up front,
+// so every call is inlined and non-virtual. TScale is one of LogScale, OctaveScale or LinearScale.
+template <typename TScale> class FixedScale
+{
+public:
+	FixedScale(int length = 1, const SingleBound<double>& bound = SingleBound<double>(1., 2.)) : mLength(length), mBound(bound)
+	{
+		mScale.prepare(mLength, mBound);
+	}
+
+	void setLength(int length)
+	{
+		mLength = length;
+		mScale.prepare(mLength, mBound);
+	}
+
+	void setBound(const SingleBound<double>& bound)
+	{
+		mBound = bound;
+		mScale.prepare(mLength, mBound);
+	}
+
+	int getLength() { return mLength; }
+	const SingleBound<double>& getBound() { return mBound; }
+
+	forcedinline int scale(double val, bool limit = false) { return mScale.scalePrepared(val, limit); }
+	forcedinline double unscale(int val, bool limit = false) { return mScale.unscalePrepared(val, limit); }
+	forcedinline void scaleN(const double* values, int* result, size_t count, bool limit = false) { mScale.scaleN(values, result, count, limit); }
+
+private:
+	TScale mScale;
+	int mLength;
+	SingleBound<double> mBound;
 };
 }}
 #endif
@@ -0,0 +1,365 @@
+#ifndef TOMATL_SPARSE_BIN_TRACKER
+#define TOMATL_SPARSE_BIN_TRACKER
+
+#include <vector>
+#include <cmath>
+
+namespace tomatl { namespace dsp {
+
+	// Magnitudes of a handful of arbitrary frequencies (pilot tones, hum harmonics...) over a window of the latest
+	// windowLength samples, for a fraction of what a full FFT per hop costs when only 5-20 bins are needed.
+	//
+	// Sliding DFT mode updates every tracked frequency on every sample, so magnitudes can be read after any block,
+	// even a single sample one. Recursive update is damped by cDamping per sample (Jacobsen & Lyons), so rounding
+	// errors die out instead of accumulating forever. Hann window is applied in frequency domain: each frequency is
+	// tracked by three resonators (f - fs / N, f, f + fs / N), combined with -1/4, 1/2, -1/4.
+	// Goertzel mode analyzes consecutive blocks of windowLength samples and updates magnitudes once per block,
+	// at about half the cost of sliding DFT.
+	//
+	// State is stored as structure of arrays across resonators, so per-sample loops run over contiguous arrays
+	// and are vectorized across tracked frequencies.
+	//
+	// Output is a sparse SpectrumBlock: bins are not equally spaced, mData[i].first holds frequency in Hz and
+	// getBinFrequency(i) returns it. FrequencyDomainGrid places such bins by their frequencies (without interpolating
+	// between them), SpectralPeakDetector treats each of them as a separate partial.
+	template <typename T> class SparseBinTracker
+	{
+	public:
+		enum Mode
+		{
+			modeSlidingDft = 0,
+			modeGoertzel
+		};
+
+		SparseBinTracker(double sampleRate, size_t windowLength, Mode mode = modeSlidingDft, bool windowed = true)
+			: mSampleRate(sampleRate), mWindowLength(windowLength), mMode(mode), mWindowed(windowed), mIndex(0)
+		{
+			mHistory.assign(windowLength, 0.);
+
+			// Frequency sets are applied on the processing thread, so everything they size is allocated here once
+			mOutput.reserve(cMaxFrequencies);
+			mStateRe.reserve(cMaxFrequencies * 3);
+			mStateIm.reserve(cMaxFrequencies * 3);
+			mRotationRe.reserve(cMaxFrequencies * 3);
+			mRotationIm.reserve(cMaxFrequencies * 3);
+			mTailRe.reserve(cMaxFrequencies * 3);
+			mTailIm.reserve(cMaxFrequencies * 3);
+			mCosine.reserve(cMaxFrequencies * 3);
+			mGain.reserve(cMaxFrequencies);
+
+			if (mode == modeGoertzel)
+			{
+				mWindow = WindowTableCache::get<T>(windowed ? WindowFunctionFactory::windowHann : WindowFunctionFactory::windowRectangle, windowLength, false);
+			}
+
+			calculateNormalization();
+			reset();
+		}
+
+		// Maximal number of tracked frequencies
+		static const size_t cMaxFrequencies = 32;
+
+		// Control thread. Picked up by the next process() call, which restarts tracking of all frequencies.
+		// Frequencies outside of (0, Nyquist) are not tracked and always read zero. Returns false if count is above cMaxFrequencies.
+		bool setFrequencies(const double* frequencies, size_t count)
+		{
+			if (count > cMaxFrequencies)
+			{
+				return false;
+			}
+
+			FrequencySet& set = mPostedFrequencies.edit();
+
+			std::copy(frequencies, frequencies + count, set.mFrequencies);
+			set.mCount = count;
+			mPostedFrequencies.commit();
+
+			return true;
+		}
+
+		// Getters below belong to the thread which calls process()
+		size_t getBinCount() { return mOutput.size(); }
+		double getFrequency(size_t bin) { return mOutput[bin].first; }
+		double getMagnitude(size_t bin) { return mOutput[bin].second; }
+		size_t getWindowLength() { return mWindowLength; }
+
+		void reset()
+		{
+			std::fill(mHistory.begin(), mHistory.end(), 0.);
+			std::fill(mStateRe.begin(), mStateRe.end(), 0.);
+			std::fill(mStateIm.begin(), mStateIm.end(), 0.);
+
+			for (size_t i = 0; i < mOutput.size(); ++i)
+			{
+				mOutput[i].second = 0.;
+			}
+
+			mPosition = 0;
+			mSamplesSeen = 0;
+		}
+
+		// Returns block with current magnitudes, or block with NULL data if there is no (new) estimate yet:
+		// in sliding mode until the first window is filled, in Goertzel mode unless a block was completed.
+		SpectrumBlock process(const T* input, size_t count, double sampleRate)
+		{
+			TOMATL_RT_SCOPE();
+
+			if (sampleRate != mSampleRate)
+			{
+				mSampleRate = sampleRate;
+				calculateNormalization();
+				calculateCoefficients();
+				reset();
+			}
+
+			if (mPostedFrequencies.pickUp())
+			{
+				applyFrequencies(mPostedFrequencies.current());
+			}
+
+			if (mOutput.empty())
+			{
+				return SpectrumBlock();
+			}
+
+			bool ready = (mMode == modeSlidingDft) ? processSliding(input, count) : processGoertzel(input, count);
+
+			if (!ready)
+			{
+				return SpectrumBlock();
+			}
+
+			SpectrumBlock result(mOutput.size(), &mOutput[0], mIndex, mSampleRate, 0., 0.);
+			result.mSparse = true;
+
+			return result;
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(SparseBinTracker);
+
+		struct FrequencySet
+		{
+			FrequencySet() : mCount(0)
+			{
+				std::fill(mFrequencies, mFrequencies + cMaxFrequencies, 0.);
+			}
+
+			double mFrequencies[cMaxFrequencies];
+			size_t mCount;
+		};
+
+		// Per-sample damping of sliding DFT, error time constant of 100000 samples
+		static constexpr double cDamping = 0.99999;
+
+		// Sizes stay within capacity reserved by the constructor, so nothing is allocated
+		void applyFrequencies(const FrequencySet& set)
+		{
+			const size_t count = set.mCount;
+			const size_t resonatorCount = count * getPlaneCount();
+
+			mOutput.resize(count);
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				mOutput[i] = std::pair<double, double>(set.mFrequencies[i], 0.);
+			}
+
+			mStateRe.resize(resonatorCount);
+			mStateIm.resize(resonatorCount);
+			mRotationRe.resize(resonatorCount);
+			mRotationIm.resize(resonatorCount);
+			mTailRe.resize(resonatorCount);
+			mTailIm.resize(resonatorCount);
+			mCosine.resize(resonatorCount);
+			mGain.resize(count);
+
+			calculateCoefficients();
+			reset();
+		}
+
+		size_t getPlaneCount() { return (mMode == modeSlidingDft && mWindowed) ? 3 : 1; }
+
+		// Resonator r of plane p tracks frequency of bin r % binCount shifted by (p - 1) DFT bins
+		double getResonatorOmega(size_t resonator)
+		{
+			const size_t binCount = mOutput.size();
+			double shift = (getPlaneCount() == 3) ? (double)(resonator / binCount) - 1. : 0.;
+			double frequency = mOutput[resonator % binCount].first;
+
+			return 2. * TOMATL_PI * (frequency / mSampleRate + shift / mWindowLength);
+		}
+
+		void calculateCoefficients()
+		{
+			const double tailDamping = std::pow(cDamping, (double)mWindowLength);
+
+			for (size_t r = 0; r < mStateRe.size(); ++r)
+			{
+				double omega = getResonatorOmega(r);
+
+				// S[n] = d * e^(jw) * S[n - 1] + x[n] - d^N * e^(jwN) * x[n - N] is a sum of d^m * e^(jwm) * x[n - m] over the window
+				mRotationRe[r] = cDamping * std::cos(omega);
+				mRotationIm[r] = cDamping * std::sin(omega);
+				mTailRe[r] = tailDamping * std::cos(omega * mWindowLength);
+				mTailIm[r] = tailDamping * std::sin(omega * mWindowLength);
+				mCosine[r] = std::cos(omega);
+			}
+
+			// Output scale per frequency, zero for the ones which can't be tracked (they'd alias or read DC)
+			for (size_t bin = 0; bin < mOutput.size(); ++bin)
+			{
+				double frequency = mOutput[bin].first;
+
+				mGain[bin] = (frequency > 0. && frequency < mSampleRate * 0.5) ? mNormalization : 0.;
+			}
+		}
+
+		// 2 / sum of effective window weights, so a sine reads its amplitude, same as SpectroCalculator
+		void calculateNormalization()
+		{
+			double sum = 0.;
+
+			for (size_t m = 0; m < mWindowLength; ++m)
+			{
+				if (mMode == modeGoertzel)
+				{
+					sum += mWindow->getData()[m];
+				}
+				else
+				{
+					double weight = mWindowed ? 0.5 - 0.5 * std::cos(2. * TOMATL_PI * m / mWindowLength) : 1.;
+
+					sum += weight * std::pow(cDamping, (double)m);
+				}
+			}
+
+			mNormalization = 2. / sum;
+		}
+
+		bool processSliding(const T* input, size_t count)
+		{
+			const size_t resonatorCount = mStateRe.size();
+			double* re = &mStateRe[0];
+			double* im = &mStateIm[0];
+			const double* rotationRe = &mRotationRe[0];
+			const double* rotationIm = &mRotationIm[0];
+			const double* tailRe = &mTailRe[0];
+			const double* tailIm = &mTailIm[0];
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const double x = input[i];
+				const double old = mHistory[mPosition];
+
+				mHistory[mPosition] = input[i];
+				mPosition = (mPosition + 1) % mWindowLength;
+
+				for (size_t r = 0; r < resonatorCount; ++r)
+				{
+					double nextRe = rotationRe[r] * re[r] - rotationIm[r] * im[r] + x - tailRe[r] * old;
+					double nextIm = rotationRe[r] * im[r] + rotationIm[r] * re[r] - tailIm[r] * old;
+
+					re[r] = nextRe;
+					im[r] = nextIm;
+				}
+			}
+
+			mSamplesSeen += count;
+
+			if (mSamplesSeen < mWindowLength)
+			{
+				return false;
+			}
+
+			const size_t binCount = mOutput.size();
+
+			for (size_t bin = 0; bin < binCount; ++bin)
+			{
+				double valueRe = re[bin];
+				double valueIm = im[bin];
+
+				// Hann window as convolution in frequency domain, w[m] = 1/2 - 1/4 * e^(j2pi m/N) - 1/4 * e^(-j2pi m/N)
+				if (mWindowed)
+				{
+					valueRe = 0.5 * re[binCount + bin] - 0.25 * (re[bin] + re[binCount * 2 + bin]);
+					valueIm = 0.5 * im[binCount + bin] - 0.25 * (im[bin] + im[binCount * 2 + bin]);
+				}
+
+				mOutput[bin].second = std::sqrt(valueRe * valueRe + valueIm * valueIm) * mGain[bin];
+			}
+
+			++mIndex;
+
+			return true;
+		}
+
+		bool processGoertzel(const T* input, size_t count)
+		{
+			const size_t binCount = mOutput.size();
+			const T* window = mWindow->getData();
+			double* s1 = &mStateRe[0];
+			double* s2 = &mStateIm[0];
+			const double* cosine = &mCosine[0];
+			bool ready = false;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				const double x = input[i] * window[mPosition];
+
+				for (size_t bin = 0; bin < binCount; ++bin)
+				{
+					double s = x + 2. * cosine[bin] * s1[bin] - s2[bin];
+
+					s2[bin] = s1[bin];
+					s1[bin] = s;
+				}
+
+				++mPosition;
+
+				if (mPosition >= mWindowLength)
+				{
+					for (size_t bin = 0; bin < binCount; ++bin)
+					{
+						double power = s1[bin] * s1[bin] + s2[bin] * s2[bin] - 2. * cosine[bin] * s1[bin] * s2[bin];
+
+						mOutput[bin].second = std::sqrt(std::max(0., power)) * mGain[bin];
+						s1[bin] = s2[bin] = 0.;
+					}
+
+					mPosition = 0;
+					++mIndex;
+					ready = true;
+				}
+			}
+
+			return ready;
+		}
+
+		double mSampleRate;
+		size_t mWindowLength;
+		Mode mMode;
+		bool mWindowed;
+		size_t mIndex;
+		size_t mPosition;
+		size_t mSamplesSeen;
+		double mNormalization;
+		std::shared_ptr<const WindowTable<T>> mWindow;
+		std::vector<T> mHistory;
+		std::vector<double> mStateRe;		// Goertzel s[n - 1] in Goertzel mode
+		std::vector<double> mStateIm;		// Goertzel s[n - 2] in Goertzel mode
+		std::vector<double> mRotationRe;
+		std::vector<double> mRotationIm;
+		std::vector<double> mTailRe;
+		std::vector<double> mTailIm;
+		std::vector<double> mCosine;
+		std::vector<double> mGain;
+		std::vector<std::pair<double, double>> mOutput;
+		ParameterExchange<FrequencySet> mPostedFrequencies;
+	};
+
+	template <typename T> constexpr double SparseBinTracker<T>::cDamping;
+
+}}
+
+#endif
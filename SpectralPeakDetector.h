@@ -0,0 +1,290 @@
+#ifndef TOMATL_SPECTRAL_PEAK_DETECTOR
+#define TOMATL_SPECTRAL_PEAK_DETECTOR
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+namespace tomatl { namespace dsp {
+
+	struct SpectralPeak
+	{
+		SpectralPeak() : mFrequency(0.), mAmplitude(0.), mBin(0.), mTrackId(0), mTrackAge(0)
+		{
+		}
+
+		FrequencyDomainGrid::NoteNotation getNote() const
+		{
+			return FrequencyDomainGrid::NoteNotation::fromFrequency(mFrequency);
+		}
+
+		double mFrequency;	// Interpolated, Hz
+		double mAmplitude;	// Interpolated, linear - same units as SpectrumBlock data
+		double mBin;		// Fractional bin position
+		size_t mTrackId;	// Same id across frames as long as partial is being tracked
+		size_t mTrackAge;	// Number of previous frames this partial was matched in
+	};
+
+	struct SpectralPeakList
+	{
+		SpectralPeakList()
+		{
+			mCount = 0;
+			mPeaks = NULL;
+			mIndex = 0;
+			mSampleRate = 0;
+		}
+
+		SpectralPeakList(size_t count, const SpectralPeak* peaks, size_t index, size_t sampleRate)
+		{
+			mCount = count;
+			mPeaks = peaks;
+			mIndex = index;
+			mSampleRate = sampleRate;
+		}
+
+		// Peaks are sorted by frequency, so UI hover lookup doesn't need to touch the full frame
+		const SpectralPeak* findNearest(double frequency) const
+		{
+			if (mCount == 0)
+			{
+				return NULL;
+			}
+
+			const SpectralPeak* it = std::lower_bound(mPeaks, mPeaks + mCount, frequency,
+				[](const SpectralPeak& peak, double freq) { return peak.mFrequency < freq; });
+
+			if (it == mPeaks + mCount)
+			{
+				return it - 1;
+			}
+
+			if (it != mPeaks && (frequency - (it - 1)->mFrequency) < (it->mFrequency - frequency))
+			{
+				return it - 1;
+			}
+
+			return it;
+		}
+
+		size_t mCount;
+		const SpectralPeak* mPeaks;
+		size_t mIndex;
+		size_t mSampleRate;
+	};
+
+	// Picks thresholded local maxima from SpectrumBlock frames, refines them to sub-bin precision
+	// and links peaks of consecutive frames into partials.
+	class SpectralPeakDetector
+	{
+	public:
+		enum Interpolation
+		{
+			interpolationNone = 0,
+			interpolationParabolic,	// Parabola through linear magnitudes
+			interpolationGaussian	// Parabola through log magnitudes, exact for Gaussian window and close for Hann/Blackman-Harris
+		};
+
+		SpectralPeakDetector(size_t maxPeaks = 64, double thresholdDb = -80., Interpolation interpolation = interpolationGaussian)
+			: mMaxPeaks(maxPeaks), mInterpolation(interpolation), mNextTrackId(1)
+		{
+			setThreshold(thresholdDb);
+			setTrackingTolerance(50.);
+
+			mPeaks.reserve(mMaxPeaks);
+			mPreviousPeaks.reserve(mMaxPeaks);
+			mMatched.reserve(mMaxPeaks);
+		}
+
+		void setThreshold(double thresholdDb)
+		{
+			mThresholdDb = thresholdDb;
+			mThreshold = std::pow(10., thresholdDb / 20.);
+		}
+
+		// Max frequency deviation between frames (in cents) for peaks to be considered the same partial
+		void setTrackingTolerance(double cents)
+		{
+			mToleranceCents = cents;
+		}
+
+		void setInterpolation(Interpolation interpolation) { mInterpolation = interpolation; }
+
+		void reset()
+		{
+			mPeaks.clear();
+			mPreviousPeaks.clear();
+		}
+
+		// Empty blocks (SpectroCalculator::process() returns them between frames) are ignored and don't break tracking
+		SpectralPeakList process(const SpectrumBlock& block)
+		{
+			if (block.mData == NULL || (block.mLength < 3 && !block.mSparse))
+			{
+				return SpectralPeakList();
+			}
+
+			std::swap(mPeaks, mPreviousPeaks);
+			mPeaks.clear();
+
+			// Reallocates only when frame size changes. Local maxima are at most every other bin, sparse bins may all be peaks.
+			size_t maxCandidates = block.mSparse ? block.mLength : block.mLength / 2;
+
+			if (mCandidates.capacity() < maxCandidates)
+			{
+				mCandidates.reserve(maxCandidates);
+			}
+
+			mCandidates.clear();
+
+			const std::pair<double, double>* data = block.mData;
+
+			if (block.mSparse)
+			{
+				// Neighbours are unrelated frequencies, each bin above threshold is a partial of its own
+				for (size_t bin = 0; bin < block.mLength; ++bin)
+				{
+					if (data[bin].second > mThreshold)
+					{
+						SpectralPeak peak;
+						peak.mBin = bin;
+						peak.mFrequency = data[bin].first;
+						peak.mAmplitude = data[bin].second;
+
+						mCandidates.push_back(peak);
+					}
+				}
+			}
+			else
+			{
+				for (size_t bin = 1; bin < block.mLength - 1; ++bin)
+				{
+					const double& current = data[bin].second;
+
+					if (current > mThreshold && current > data[bin - 1].second && current >= data[bin + 1].second)
+					{
+						mCandidates.push_back(refinePeak(block, bin));
+					}
+				}
+			}
+
+			// Keep only the strongest ones if there are too many
+			if (mCandidates.size() > mMaxPeaks)
+			{
+				std::nth_element(mCandidates.begin(), mCandidates.begin() + mMaxPeaks, mCandidates.end(),
+					[](const SpectralPeak& a, const SpectralPeak& b) { return a.mAmplitude > b.mAmplitude; });
+
+				mCandidates.resize(mMaxPeaks);
+			}
+
+			mPeaks.assign(mCandidates.begin(), mCandidates.end());
+
+			trackPartials();
+
+			std::sort(mPeaks.begin(), mPeaks.end(), [](const SpectralPeak& a, const SpectralPeak& b) { return a.mFrequency < b.mFrequency; });
+
+			return SpectralPeakList(mPeaks.size(), mPeaks.empty() ? NULL : &mPeaks[0], block.mIndex, block.mSampleRate);
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(SpectralPeakDetector);
+
+		SpectralPeak refinePeak(const SpectrumBlock& block, size_t bin)
+		{
+			double alpha = block.mData[bin - 1].second;
+			double beta = block.mData[bin].second;
+			double gamma = block.mData[bin + 1].second;
+
+			double offset = 0.;
+			double amplitude = beta;
+
+			if (mInterpolation == interpolationGaussian && alpha > 0. && gamma > 0.)
+			{
+				alpha = std::log(alpha);
+				beta = std::log(beta);
+				gamma = std::log(gamma);
+			}
+			else if (mInterpolation == interpolationNone)
+			{
+				alpha = gamma = beta;
+			}
+
+			double denominator = alpha - 2. * beta + gamma;
+
+			if (denominator != 0.)
+			{
+				offset = 0.5 * (alpha - gamma) / denominator;
+				amplitude = beta - 0.25 * (alpha - gamma) * offset;
+
+				if (mInterpolation == interpolationGaussian && block.mData[bin - 1].second > 0. && block.mData[bin + 1].second > 0.)
+				{
+					amplitude = std::exp(amplitude);
+				}
+			}
+
+			SpectralPeak result;
+			result.mBin = bin + offset;
+			result.mFrequency = block.getBinFrequency(result.mBin);
+			result.mAmplitude = amplitude;
+
+			return result;
+		}
+
+		// Greedy matching, strongest peaks pick their predecessors first. Peak counts are small, so quadratic search is fine.
+		void trackPartials()
+		{
+			std::sort(mPeaks.begin(), mPeaks.end(), [](const SpectralPeak& a, const SpectralPeak& b) { return a.mAmplitude > b.mAmplitude; });
+
+			mMatched.assign(mPreviousPeaks.size(), false);
+
+			for (size_t i = 0; i < mPeaks.size(); ++i)
+			{
+				SpectralPeak& peak = mPeaks[i];
+				int best = -1;
+				double bestDistance = mToleranceCents;
+
+				for (size_t j = 0; j < mPreviousPeaks.size(); ++j)
+				{
+					if (mMatched[j] || mPreviousPeaks[j].mFrequency <= 0. || peak.mFrequency <= 0.)
+					{
+						continue;
+					}
+
+					double distance = std::abs(1200. * std::log2(peak.mFrequency / mPreviousPeaks[j].mFrequency));
+
+					if (distance <= bestDistance)
+					{
+						best = (int)j;
+						bestDistance = distance;
+					}
+				}
+
+				if (best >= 0)
+				{
+					mMatched[best] = true;
+					peak.mTrackId = mPreviousPeaks[best].mTrackId;
+					peak.mTrackAge = mPreviousPeaks[best].mTrackAge + 1;
+				}
+				else
+				{
+					peak.mTrackId = mNextTrackId++;
+					peak.mTrackAge = 0;
+				}
+			}
+		}
+
+		std::vector<SpectralPeak> mCandidates;
+		std::vector<SpectralPeak> mPeaks;
+		std::vector<SpectralPeak> mPreviousPeaks;
+		std::vector<bool> mMatched;
+		size_t mMaxPeaks;
+		Interpolation mInterpolation;
+		size_t mNextTrackId;
+		double mThreshold;
+		double mThresholdDb;
+		double mToleranceCents;
+	};
+
+}}
+
+#endif
@@ -15,15 +15,49 @@ namespace tomatl { namespace dsp {
 			mIndex = 0;
 			mSampleRate = 0;
 			mFramesRendered = 0;
+			mFrequencyOffset = 0.;
+			mBinWidth = 0.;
+			mSparse = false;
 		}
 
-		SpectrumBlock(size_t size, std::pair<double, double>* data, size_t index, size_t sampleRate)
+		// Regular real FFT frame: bins from DC up to Nyquist of (possibly fractional) sampleRate
+		SpectrumBlock(size_t size, std::pair<double, double>* data, size_t index, double sampleRate)
 		{
 			mLength = size;
 			mData = data;
 			mIndex = index;
-			mSampleRate = sampleRate;
+			mSampleRate = (size_t)sampleRate;
+			mFramesRendered = 0;
+			mFrequencyOffset = 0.;
+			mBinWidth = size > 0 ? sampleRate / (size * 2.) : 0.;
+			mSparse = false;
+		}
+
+		// Arbitrary band (zoom analysis): bin i is at frequencyOffset + i * binWidth
+		SpectrumBlock(size_t size, std::pair<double, double>* data, size_t index, double sampleRate, double frequencyOffset, double binWidth)
+		{
+			mLength = size;
+			mData = data;
+			mIndex = index;
+			mSampleRate = (size_t)sampleRate;
 			mFramesRendered = 0;
+			mFrequencyOffset = frequencyOffset;
+			mBinWidth = binWidth;
+			mSparse = false;
+		}
+
+		// mData[i].first holds bin number, this converts it (or fractional bin position) to Hz.
+		// Sparse blocks have frequencies in mData[i].first, so bin position is rounded to the nearest entry.
+		forcedinline double getBinFrequency(const double& bin) const
+		{
+			if (mSparse)
+			{
+				size_t index = std::min((size_t)(std::max(0., bin) + 0.5), mLength - 1);
+
+				return mData[index].first;
+			}
+
+			return mFrequencyOffset + bin * mBinWidth;
 		}
 
 		size_t mLength;
@@ -31,22 +65,63 @@ namespace tomatl { namespace dsp {
 		size_t mSampleRate;
 		size_t mFramesRendered;
 		std::pair<double, double>* mData;
+		double mFrequencyOffset;	// Frequency of bin 0, Hz
+		double mBinWidth;			// Hz
+		bool mSparse;				// Bins are not equally spaced, mData[i].first holds frequency in Hz (see SparseBinTracker)
 	};
 
 	template <typename T> class SpectroCalculator
 	{
 	public:
+		// Outputs computed from channel frames in frequency domain, without running extra FFTs.
+		// Sum, mid and side use first two channels, max uses all of them.
+		enum DerivedOutput
+		{
+			derivedSum = 0,	// |L + R|
+			derivedMid,		// |L + R| / 2
+			derivedSide,	// |L - R| / 2
+			derivedMax,		// Max of (smoothed) channel magnitudes
+			derivedCount
+		};
+
+		// Hot path stages measured when compiled with TOMATL_ENABLE_PROFILING
+		enum ProfileStage
+		{
+			profileWindow = 0,
+			profileFft,
+			profilePhase,
+			profileMagnitude,
+			profileSmoothing,
+			profileDerived,
+			profileStageCount
+		};
+
+		// Settings which may be changed from another thread through postParameters()
+		struct Parameters
+		{
+			Parameters(double attackMs = 0., double releaseMs = 0., double sampleRate = 0.)
+				: mAttackMs(attackMs), mReleaseMs(releaseMs), mSampleRate(sampleRate)
+			{
+			}
+
+			double mAttackMs;
+			double mReleaseMs;
+			double mSampleRate;
+		};
+
 		SpectroCalculator(double sampleRate, std::pair<double, double> attackRelease, size_t index, size_t fftSize = 1024, size_t channelCount = 2) : 
-			mWindowFunction(new WindowFunction<T>(fftSize, WindowFunctionFactory::getWindowCalculator<double>(WindowFunctionFactory::windowHann), true))
+			mWindow(WindowTableCache::get<T>(WindowFunctionFactory::windowHann, fftSize, true)),
+			mParameters(Parameters(attackRelease.first, attackRelease.second, sampleRate))
 		{
-			mData = new std::pair<double, double>[fftSize];
-			memset(mData, 0x0, sizeof(std::pair<double, double>) * fftSize);
-			mChannelCount = channelCount;
 			mFftSize = fftSize;
 			mIndex = index;
 			mSampleRate = sampleRate;
 			mChannelCount = 0;
+			mPhaseEnabled = false;
+			mDerivedEnabled.assign(derivedCount, false);
+			mDerivedEnabled[derivedMax] = channelCount > 1;
 			checkChannelCount(channelCount);
+			updateActiveBinRanges();
 
 			setAttackSpeed(attackRelease.first);
 			setReleaseSpeed(attackRelease.second);
@@ -54,8 +129,6 @@ namespace tomatl { namespace dsp {
 
 		~SpectroCalculator()
 		{
-			TOMATL_BRACE_DELETE(mData);
-
 			for (int i = 0; i < mChannelCount; ++i)
 			{
 				TOMATL_DELETE(mBuffers[i]);
@@ -82,6 +155,12 @@ namespace tomatl { namespace dsp {
 					mBuffers.push_back(new OverlappingBufferSequence<T>(mFftSize * 2, mFftSize));
 				}
 
+				mChannelData.assign(mChannelCount, std::vector<std::pair<double, double>>(mFftSize / 2, std::pair<double, double>(0., 0.)));
+				mReadyFrames.assign(mChannelCount, NULL);
+				mMagnitudes.resize(mFftSize / 2);
+				prepareDerivedData();
+				preparePhaseData();
+
 				setReleaseSpeed(mReleaseMs);
 				setAttackSpeed(mAttackMs);
 
@@ -108,17 +187,129 @@ namespace tomatl { namespace dsp {
 		void setReleaseSpeed(double speed)
 		{
 			mReleaseMs = speed;
-			mAttackRelease.second = tomatl::dsp::EnvelopeWalker::calculateCoeff(speed, mSampleRate / mFftSize / mBuffers[0]->getOverlappingFactor() * mChannelCount);
+			mAttackRelease.second = tomatl::dsp::EnvelopeWalker::calculateCoeff(speed, mSampleRate / mFftSize / mBuffers[0]->getOverlappingFactor());
 		}
 
 		void setAttackSpeed(double speed)
 		{
 			mAttackMs = speed;
-			mAttackRelease.first = tomatl::dsp::EnvelopeWalker::calculateCoeff(speed, mSampleRate / mFftSize / mBuffers[0]->getOverlappingFactor() * mChannelCount);
+			mAttackRelease.first = tomatl::dsp::EnvelopeWalker::calculateCoeff(speed, mSampleRate / mFftSize / mBuffers[0]->getOverlappingFactor());
+		}
+
+		// Per-frame timing of given stage, can be called from any thread. Empty unless compiled with TOMATL_ENABLE_PROFILING.
+		ProfileSnapshot getProfile(ProfileStage stage)
+		{
+			return mProfiler.getSnapshot(stage);
+		}
+
+		// Control thread. Direct setters above are only safe on the thread which calls process(), this can be called from
+		// any single other thread: the whole set is picked up by process() at the next frame boundary, which is where
+		// smoothing coefficients are used, so attack and release never get applied from different updates.
+		void postParameters(const Parameters& params)
+		{
+			mParameters.post(params);
+		}
+
+		// Derived outputs are computed only when enabled, max-of-channels is enabled by default for multichannel input.
+		// Should be toggled from the same thread which calls process() as it (re)allocates output arrays.
+		void setDerivedOutputEnabled(DerivedOutput type, bool value)
+		{
+			mDerivedEnabled[type] = value;
+			prepareDerivedData();
+		}
+
+		bool isDerivedOutputEnabled(DerivedOutput type)
+		{
+			return mDerivedEnabled[type] && (type == derivedMax || (mChannelCount >= 2 && !isMultitaperEnabled()));
+		}
+
+		// Number of bin range slots, see setBinRange()
+		static const size_t cMaxBinRanges = 8;
+
+		// Control thread. Restricts work after the FFT (magnitudes, smoothing, phase, derived outputs) to the union of
+		// registered bin ranges [firstBin, endBin), e.g. one slot per view showing this analyzer with its
+		// FrequencyDomainGrid::getVisibleBinRange(), and prunes the FFT down to their hull. Bins outside keep their
+		// last values. With no ranges registered all bins are computed. Picked up at the next frame boundary, like postParameters().
+		bool setBinRange(size_t slot, size_t firstBin, size_t endBin)
+		{
+			if (slot >= cMaxBinRanges)
+			{
+				return false;
+			}
+
+			mPostedRanges.edit().mRanges[slot] = std::pair<size_t, size_t>(firstBin, endBin);
+			mPostedRanges.commit();
+
+			return true;
+		}
+
+		bool clearBinRange(size_t slot)
+		{
+			return setBinRange(slot, 0, 0);
+		}
+
+		// Smoothed spectrum of a single channel, updated each time process() returns non-empty block
+		SpectrumBlock getChannelOutput(size_t channel)
+		{
+			return SpectrumBlock(mFftSize / 2, &mChannelData[channel][0], mIndex, mSampleRate);
+		}
+
+		// Empty block if given output is disabled or not applicable to current channel count
+		SpectrumBlock getDerivedOutput(DerivedOutput type)
+		{
+			if (isDerivedOutputEnabled(type))
+			{
+				return SpectrumBlock(mFftSize / 2, &mDerivedData[type][0], mIndex, mSampleRate);
+			}
+			else
+			{
+				return SpectrumBlock();
+			}
+		}
+
+		// Replaces Hann-windowed FFT with multitaper estimate (see MultitaperEstimator): much lower variance from a single frame
+		// for ceil(taperCount / 2) FFTs. Magnitudes only - phase and sum/mid/side outputs are not available in this mode.
+		// Should be toggled from the same thread which calls process() as it allocates and calculates tapers.
+		void setMultitaperEnabled(bool value, double timeBandwidth = 4., size_t taperCount = 0)
+		{
+			if (value)
+			{
+				mMultitaper.reset(new MultitaperEstimator<T>(mFftSize, timeBandwidth, taperCount));
+			}
+			else
+			{
+				mMultitaper.reset();
+			}
+		}
+
+		bool isMultitaperEnabled() { return mMultitaper != NULL; }
+
+		// Phase output is off by default, so magnitude-only consumers don't pay for atan2 and unwrapping.
+		// Should be toggled from the same thread which calls process() as it (re)allocates output arrays.
+		void setPhaseOutputEnabled(bool value)
+		{
+			mPhaseEnabled = value;
+			preparePhaseData();
+		}
+
+		bool isPhaseOutputEnabled() { return mPhaseEnabled; }
+
+		// Unwrapped phase (radians) of the last completed frame of given channel, NULL if phase output is disabled
+		const double* getPhase(size_t channel)
+		{
+			return (mPhaseEnabled && !isMultitaperEnabled()) ? &mPhase[channel][0] : NULL;
+		}
+
+		// Group delay (seconds, relative to the frame start) of the last completed frame of given channel, NULL if phase output is disabled
+		const double* getGroupDelay(size_t channel)
+		{
+			return (mPhaseEnabled && !isMultitaperEnabled()) ? &mGroupDelay[channel][0] : NULL;
 		}
 
 		SpectrumBlock process(T* channels)
 		{
+			TOMATL_RT_SCOPE();
+
 			bool processed = false;
 
 			for (int i = 0; i < mChannelCount; ++i)
@@ -127,12 +318,28 @@ namespace tomatl { namespace dsp {
 				mBuffers[i]->putOne(channels[i]);
 				auto chData = mBuffers[i]->putOne(0.);
 
-				processed = processed || calculateSpectrumFromChannelBufferIfReady(std::get<0>(chData));
+				mReadyFrames[i] = std::get<0>(chData);
 			}
 
+			if (mReadyFrames[0] != NULL)
+			{
+				applyPostedParameters();
+			}
+
+			for (size_t i = 0; i < mChannelCount; ++i)
+			{
+				processed = calculateSpectrumFromChannelBufferIfReady(mReadyFrames[i], i) || processed;
+			}
+
+			// All channel buffers advance in lockstep, so either all of them are ready or none
 			if (processed)
 			{
-				return SpectrumBlock(mFftSize / 2., mData, mIndex, mSampleRate);
+				TOMATL_PROFILE_START(mProfiler);
+				calculateDerivedOutputs();
+				TOMATL_PROFILE_LAP(mProfiler, profileDerived);
+
+				// Max-of-channels frame if it's enabled, first channel otherwise. Rest is available through getters.
+				return isDerivedOutputEnabled(derivedMax) ? getDerivedOutput(derivedMax) : getChannelOutput(0);
 			}
 			else
 			{
@@ -141,74 +348,363 @@ namespace tomatl { namespace dsp {
 		}
 
 	private:
+		struct BinRangeSet
+		{
+			BinRangeSet()
+			{
+				std::fill(mRanges, mRanges + cMaxBinRanges, std::pair<size_t, size_t>(0, 0));
+			}
+
+			std::pair<size_t, size_t> mRanges[cMaxBinRanges]; // Empty slots have first >= end
+		};
 
-		bool calculateSpectrumFromChannelBufferIfReady(T* chData)
+		void applyPostedParameters()
 		{
-			if (chData != NULL)
+			if (mPostedRanges.pickUp())
+			{
+				updateActiveBinRanges();
+			}
+
+			if (mParameters.pickUp())
 			{
-				// Apply window function to buffer
-				for (int s = 0; s < mFftSize; ++s)
+				const Parameters& params = mParameters.current();
+
+				if (params.mSampleRate > 0.)
 				{
-					mWindowFunction->applyFunction(chData + s * 2, s, 1, true);
+					checkSampleRate(params.mSampleRate);
 				}
 
-				// In-place calculate FFT
-				FftCalculator<T>::calculateFast(chData, mFftSize);
+				setAttackSpeed(params.mAttackMs);
+				setReleaseSpeed(params.mReleaseMs);
+			}
+		}
+
+		// Sorted, merged and clamped copy of registered ranges, so per-bin loops visit each bin once
+		void updateActiveBinRanges()
+		{
+			const size_t binCount = mFftSize / 2;
+			const BinRangeSet& posted = mPostedRanges.current();
 
-				// Calculate frequency-magnitude pairs (omitting phase information, as we won't need it) for all frequency bins
-				for (int bin = 0; bin < (mFftSize / 2.); ++bin)
+			mActiveRangeCount = 0;
+
+			for (size_t i = 0; i < cMaxBinRanges; ++i)
+			{
+				size_t first = posted.mRanges[i].first;
+				size_t end = std::min(posted.mRanges[i].second, binCount);
+
+				if (first < end)
 				{
-					T ampl = 0.;
+					mActiveRanges[mActiveRangeCount++] = std::pair<size_t, size_t>(first, end);
+				}
+			}
 
-					T* ftResult = chData;
+			if (mActiveRangeCount == 0)
+			{
+				mActiveRanges[mActiveRangeCount++] = std::pair<size_t, size_t>(0, binCount);
+			}
 
-					// FFT bin in rectangle form
-					T mFftSin = ftResult[bin * 2];
-					T mFftCos = ftResult[bin * 2 + 1];
+			std::sort(mActiveRanges, mActiveRanges + mActiveRangeCount);
 
-					// http://www.dsprelated.com/showmessage/69952/1.php or see below
-					mFftSin *= 2;
-					mFftCos *= 2;
-					mFftSin /= mFftSize;
-					mFftCos /= mFftSize;
+			size_t merged = 0;
 
-					// Partial conversion to polar coordinates: we calculate radius vector length, but don't calculate angle (aka phase) as we won't need it
-					T nw = std::sqrt(mFftSin * mFftSin + mFftCos * mFftCos);
+			for (size_t i = 1; i < mActiveRangeCount; ++i)
+			{
+				if (mActiveRanges[i].first <= mActiveRanges[merged].second)
+				{
+					mActiveRanges[merged].second = std::max(mActiveRanges[merged].second, mActiveRanges[i].second);
+				}
+				else
+				{
+					mActiveRanges[++merged] = mActiveRanges[i];
+				}
+			}
 
-					ampl = std::max(nw, ampl);
+			mActiveRangeCount = merged + 1;
+			mHullFirst = mActiveRanges[0].first;
+			mHullEnd = mActiveRanges[mActiveRangeCount - 1].second;
+		}
 
-					double prev = mData[bin].second;
+		void prepareDerivedData()
+		{
+			mDerivedData.resize(derivedCount);
 
-					// Special case - hold spectrum (aka infinite release time)
-					if (mAttackRelease.second == std::numeric_limits<double>::infinity())
+			for (int i = 0; i < derivedCount; ++i)
+			{
+				if (mDerivedEnabled[i])
+				{
+					mDerivedData[i].assign(mFftSize / 2, std::pair<double, double>(0., 0.));
+
+					for (size_t bin = 0; bin < mFftSize / 2; ++bin)
 					{
-						prev = std::max(prev, ampl);
+						mDerivedData[i][bin].first = bin;
 					}
-					else // Time smoothing/averaging is being done here
+				}
+				else
+				{
+					mDerivedData[i].clear();
+				}
+			}
+		}
+
+		forcedinline void smoothBin(std::pair<double, double>* target, int bin, double ampl)
+		{
+			double prev = target[bin].second;
+
+			// Special case - hold spectrum (aka infinite release time)
+			if (mAttackRelease.second == std::numeric_limits<double>::infinity())
+			{
+				prev = std::max(prev, ampl);
+			}
+			else // Time smoothing/averaging is being done here
+			{
+				EnvelopeWalker::staticProcess(ampl, &prev, mAttackRelease.first, mAttackRelease.second);
+			}
+
+			target[bin].first = bin;
+			target[bin].second = prev;
+		}
+
+		void calculateDerivedOutputs()
+		{
+			if (isDerivedOutputEnabled(derivedSum) || isDerivedOutputEnabled(derivedMid) || isDerivedOutputEnabled(derivedSide))
+			{
+				calculateSumAndDifference();
+			}
+
+			if (mDerivedEnabled[derivedMax])
+			{
+				std::pair<double, double>* target = &mDerivedData[derivedMax][0];
+
+				for (size_t range = 0; range < mActiveRangeCount; ++range)
+				{
+					for (size_t bin = mActiveRanges[range].first; bin < mActiveRanges[range].second; ++bin)
 					{
-						EnvelopeWalker::staticProcess(ampl, &prev, mAttackRelease.first, mAttackRelease.second);
+						double value = mChannelData[0][bin].second;
+
+						for (size_t ch = 1; ch < mChannelCount; ++ch)
+						{
+							value = std::max(value, mChannelData[ch][bin].second);
+						}
+
+						target[bin].second = value;
 					}
+				}
+			}
+		}
+
+		// Needs complex spectra of the first two channels, which are still in their buffers right after calculation
+		void calculateSumAndDifference()
+		{
+			const T* left = mReadyFrames[0];
+			const T* right = mReadyFrames[1];
+			const T norm = 2. / mFftSize;
+
+			for (size_t range = 0; range < mActiveRangeCount; ++range)
+			{
+				for (size_t bin = mActiveRanges[range].first; bin < mActiveRanges[range].second; ++bin)
+				{
+					T sumRe = left[bin * 2] + right[bin * 2];
+					T sumIm = left[bin * 2 + 1] + right[bin * 2 + 1];
+					T sum = std::sqrt(sumRe * sumRe + sumIm * sumIm) * norm;
 
-					mData[bin].first = bin;
-					mData[bin].second = prev;
+					if (mDerivedEnabled[derivedSum]) smoothBin(&mDerivedData[derivedSum][0], bin, sum);
+					if (mDerivedEnabled[derivedMid]) smoothBin(&mDerivedData[derivedMid][0], bin, sum * 0.5);
+
+					if (mDerivedEnabled[derivedSide])
+					{
+						T diffRe = left[bin * 2] - right[bin * 2];
+						T diffIm = left[bin * 2 + 1] - right[bin * 2 + 1];
+
+						smoothBin(&mDerivedData[derivedSide][0], bin, std::sqrt(diffRe * diffRe + diffIm * diffIm) * norm * 0.5);
+					}
 				}
+			}
+		}
 
-				return true;
+		void preparePhaseData()
+		{
+			mPhase.clear();
+			mGroupDelay.clear();
+
+			if (mPhaseEnabled)
+			{
+				mPhase.resize(mChannelCount, std::vector<double>(mFftSize / 2, 0.));
+				mGroupDelay.resize(mChannelCount, std::vector<double>(mFftSize / 2, 0.));
 			}
+		}
 
-			return false;
+		// Over the hull of needed bins, as unwrapping and group delay need contiguous bins. With pruned ranges,
+		// unwrapped phase starts from the first needed bin, so it may differ from full range one by multiples of 2 * pi.
+		void calculatePhaseAndGroupDelay(const T* ftResult, size_t channel)
+		{
+			const int first = mHullFirst;
+			const int end = mHullEnd;
+			double* phase = &mPhase[channel][0];
+			double* delay = &mGroupDelay[channel][0];
+
+			for (int bin = first; bin < end; ++bin)
+			{
+				phase[bin] = Coord<T>::fastAtan2(ftResult[bin * 2 + 1], ftResult[bin * 2]);
+			}
+
+			if (end - first < 2)
+			{
+				delay[first] = 0.;
+
+				return;
+			}
+
+			// Unwrapping along frequency axis. Inherently sequential, but cheap compared to atan2 itself
+			double offset = 0.;
+			double prevRaw = phase[first];
+
+			for (int bin = first + 1; bin < end; ++bin)
+			{
+				double raw = phase[bin];
+				double diff = raw - prevRaw;
+
+				if (diff > TOMATL_PI)
+				{
+					offset -= 2. * TOMATL_PI;
+				}
+				else if (diff < -TOMATL_PI)
+				{
+					offset += 2. * TOMATL_PI;
+				}
+
+				prevRaw = raw;
+				phase[bin] = raw + offset;
+			}
+
+			// Group delay is -d(phase)/d(omega), bins are 2 * pi * sampleRate / fftSize radians per second apart.
+			// Central difference inside, one-sided at the edges.
+			const double binToSeconds = mFftSize / (2. * TOMATL_PI * mSampleRate);
+
+			for (int bin = first + 1; bin < end - 1; ++bin)
+			{
+				delay[bin] = -(phase[bin + 1] - phase[bin - 1]) * 0.5 * binToSeconds;
+			}
+
+			delay[first] = -(phase[first + 1] - phase[first]) * binToSeconds;
+			delay[end - 1] = -(phase[end - 1] - phase[end - 2]) * binToSeconds;
+		}
+
+		bool calculateSpectrumFromChannelBufferIfReady(T* chData, size_t channel)
+		{
+			if (chData == NULL)
+			{
+				return false;
+			}
+
+			TOMATL_PROFILE_START(mProfiler);
+
+			std::pair<double, double>* output = &mChannelData[channel][0];
+
+			if (mMultitaper != NULL)
+			{
+				// Real samples are in even slots of the buffer. Tapering and FFTs are inseparable here, so all of it counts as FFT.
+				mMultitaper->calculate(chData, 2, &mMagnitudes[0]);
+				TOMATL_PROFILE_LAP(mProfiler, profileFft);
+
+				smoothMagnitudes(output);
+			}
+			else
+			{
+				// Apply window function (already scaled) to buffer. Imaginary parts are zeroes, but multiplying them too
+				// keeps the loop contiguous and vectorizable.
+				mWindow->applyToComplex(chData);
+				TOMATL_PROFILE_LAP(mProfiler, profileWindow);
+
+				// In-place calculate FFT, only as much of it as needed bins depend on
+				if (mHullFirst > 0 || mHullEnd < mFftSize / 2)
+				{
+					FftCalculator<T>::calculatePruned(chData, mFftSize, mHullFirst, mHullEnd);
+				}
+				else
+				{
+					FftCalculator<T>::calculateFast(chData, mFftSize);
+				}
+				TOMATL_PROFILE_LAP(mProfiler, profileFft);
+
+				if (mPhaseEnabled)
+				{
+					calculatePhaseAndGroupDelay(chData, channel);
+					TOMATL_PROFILE_LAP(mProfiler, profilePhase);
+				}
+
+				// Calculate magnitudes for all needed frequency bins (phase, if requested, has been taken care of above).
+				// They are smoothed right away, unless profiling needs smoothing timed as a separate pass.
+				for (size_t range = 0; range < mActiveRangeCount; ++range)
+				{
+					for (size_t bin = mActiveRanges[range].first; bin < mActiveRanges[range].second; ++bin)
+					{
+						// FFT bin in rectangle form
+						T mFftSin = chData[bin * 2];
+						T mFftCos = chData[bin * 2 + 1];
+
+						// http://www.dsprelated.com/showmessage/69952/1.php or see below
+						mFftSin *= 2;
+						mFftCos *= 2;
+						mFftSin /= mFftSize;
+						mFftCos /= mFftSize;
+
+						// Partial conversion to polar coordinates: we calculate radius vector length, angle (aka phase) is a separate optional pass
+						T magnitude = std::sqrt(mFftSin * mFftSin + mFftCos * mFftCos);
+#ifdef TOMATL_ENABLE_PROFILING
+						mMagnitudes[bin] = magnitude;
+#else
+						smoothBin(output, bin, magnitude);
+#endif
+					}
+				}
+
+				TOMATL_PROFILE_LAP(mProfiler, profileMagnitude);
+#ifdef TOMATL_ENABLE_PROFILING
+				smoothMagnitudes(output);
+#endif
+			}
+
+			TOMATL_PROFILE_LAP(mProfiler, profileSmoothing);
+
+			return true;
+		}
+
+		void smoothMagnitudes(std::pair<double, double>* output)
+		{
+			for (size_t range = 0; range < mActiveRangeCount; ++range)
+			{
+				for (size_t bin = mActiveRanges[range].first; bin < mActiveRanges[range].second; ++bin)
+				{
+					smoothBin(output, bin, mMagnitudes[bin]);
+				}
+			}
 		}
 
 		std::vector<OverlappingBufferSequence<T>*> mBuffers;
-		std::pair<double, double>* mData;
+		std::vector<std::vector<std::pair<double, double>>> mChannelData;
+		std::vector<std::vector<std::pair<double, double>>> mDerivedData;
+		std::vector<bool> mDerivedEnabled;
+		std::vector<T*> mReadyFrames;
 		std::pair<double, double> mAttackRelease;
-		std::unique_ptr<WindowFunction<T>> mWindowFunction;
+		std::shared_ptr<const WindowTable<T>> mWindow;
+		std::unique_ptr<MultitaperEstimator<T>> mMultitaper;
+		std::vector<T> mMagnitudes;
+		std::vector<std::vector<double>> mPhase;
+		std::vector<std::vector<double>> mGroupDelay;
+		bool mPhaseEnabled;
 		size_t mChannelCount;
 		size_t mFftSize;
 		size_t mIndex;
 		double mSampleRate;
 		double mAttackMs;
 		double mReleaseMs;
+		std::pair<size_t, size_t> mActiveRanges[cMaxBinRanges];
+		size_t mActiveRangeCount;
+		size_t mHullFirst;
+		size_t mHullEnd;
+		ParameterExchange<Parameters> mParameters;
+		ParameterExchange<BinRangeSet> mPostedRanges;
+		StageProfiler<profileStageCount> mProfiler;
 	};
 
 }}
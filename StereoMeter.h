@@ -0,0 +1,158 @@
+#ifndef TOMATL_STEREO_METER
+#define TOMATL_STEREO_METER
+
+namespace tomatl { namespace dsp {
+
+// Phase correlation, L/R balance and stereo width from one set of running sums.
+// Everything is derived from mean powers of L, R and their product (M/S energies are linear combinations of those),
+// so per-sample work is three multiply-adds which are accumulated in independent lanes for vectorization.
+// Integration is exponential with EnvelopeWalker time constant semantics, applied once per block.
+template <typename T> class StereoMeter
+{
+public:
+	StereoMeter(double integrationMs = 300., double sampleRate = 48000.)
+		: mIntegrationMs(integrationMs), mSampleRate(sampleRate), mCoeffLength(0), mBlockCoeff(0.), mLL(0.), mRR(0.), mLR(0.)
+	{
+	}
+
+	// Time for a step change to get within 1% of its final value
+	void setIntegrationTime(double integrationMs)
+	{
+		mIntegrationMs = integrationMs;
+		mCoeffLength = 0;
+	}
+
+	void setSampleRate(double sampleRate)
+	{
+		if (sampleRate != mSampleRate)
+		{
+			mSampleRate = sampleRate;
+			mCoeffLength = 0;
+		}
+	}
+
+	void reset()
+	{
+		mLL = mRR = mLR = 0.;
+	}
+
+	void process(const T* left, const T* right, size_t count)
+	{
+		TOMATL_RT_SCOPE();
+
+		if (count == 0)
+		{
+			return;
+		}
+
+		double ll[cLanes] = { 0. };
+		double rr[cLanes] = { 0. };
+		double lr[cLanes] = { 0. };
+
+		size_t i = 0;
+
+		for (; i + cLanes <= count; i += cLanes)
+		{
+			for (size_t lane = 0; lane < cLanes; ++lane)
+			{
+				double l = left[i + lane];
+				double r = right[i + lane];
+
+				ll[lane] += l * l;
+				rr[lane] += r * r;
+				lr[lane] += l * r;
+			}
+		}
+
+		for (; i < count; ++i)
+		{
+			double l = left[i];
+			double r = right[i];
+
+			ll[0] += l * l;
+			rr[0] += r * r;
+			lr[0] += l * r;
+		}
+
+		for (size_t lane = 1; lane < cLanes; ++lane)
+		{
+			ll[0] += ll[lane];
+			rr[0] += rr[lane];
+			lr[0] += lr[lane];
+		}
+
+		// Block of N samples is one step of a one-pole filter with coefficient c^N applied to block mean
+		double coeff = getBlockCoeff(count);
+		double norm = 1. / count;
+
+		mLL = coeff * (mLL - ll[0] * norm) + ll[0] * norm;
+		mRR = coeff * (mRR - rr[0] * norm) + rr[0] * norm;
+		mLR = coeff * (mLR - lr[0] * norm) + lr[0] * norm;
+	}
+
+	// -1 (out of phase) ... +1 (mono), 0 for silence
+	double getCorrelation()
+	{
+		double denominator = std::sqrt(mLL * mRR);
+
+		return denominator > cSilence ? TOMATL_BOUND_VALUE(mLR / denominator, -1., 1.) : 0.;
+	}
+
+	// -1 (left only) ... +1 (right only)
+	double getBalance()
+	{
+		double total = mLL + mRR;
+
+		return total > cSilence ? (mRR - mLL) / total : 0.;
+	}
+
+	// Side share of total energy: 0 for mono, 0.5 for uncorrelated channels, 1 for antiphase
+	double getWidth()
+	{
+		double mid = getMidEnergy();
+		double side = getSideEnergy();
+
+		return (mid + side) > cSilence ? side / (mid + side) : 0.;
+	}
+
+	double getMidSideRatioDb()
+	{
+		const double floor = 1e-20;
+
+		return 10. * std::log10(std::max(getMidEnergy(), floor) / std::max(getSideEnergy(), floor));
+	}
+
+	// Mean powers, M = (L + R) / 2, S = (L - R) / 2
+	double getMidEnergy() { return std::max(0., 0.25 * (mLL + mRR + 2. * mLR)); }
+	double getSideEnergy() { return std::max(0., 0.25 * (mLL + mRR - 2. * mLR)); }
+	double getLeftEnergy() { return mLL; }
+	double getRightEnergy() { return mRR; }
+
+private:
+	static const size_t cLanes = 4;
+	static constexpr double cSilence = 1e-12;
+
+	double getBlockCoeff(size_t length)
+	{
+		// Hosts tend to use the same block size all the time, so pow() is only called on changes
+		if (length != mCoeffLength)
+		{
+			mCoeffLength = length;
+			mBlockCoeff = std::pow(EnvelopeWalker::calculateCoeff(mIntegrationMs, mSampleRate), (double)length);
+		}
+
+		return mBlockCoeff;
+	}
+
+	double mIntegrationMs;
+	double mSampleRate;
+	size_t mCoeffLength;
+	double mBlockCoeff;
+	double mLL;
+	double mRR;
+	double mLR;
+};
+
+}}
+
+#endif
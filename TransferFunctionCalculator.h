@@ -0,0 +1,231 @@
+#ifndef TOMATL_TRANSFER_FUNCTION_CALCULATOR
+#define TOMATL_TRANSFER_FUNCTION_CALCULATOR
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace tomatl { namespace dsp {
+
+	struct TransferFunctionBlock
+	{
+		TransferFunctionBlock()
+		{
+			mLength = 0;
+			mIndex = 0;
+			mSampleRate = 0;
+			mFramesAveraged = 0;
+			mMagnitude = NULL;
+			mPhase = NULL;
+			mCoherence = NULL;
+		}
+
+		TransferFunctionBlock(size_t size, const double* magnitude, const double* phase, const double* coherence, size_t index, size_t sampleRate, size_t framesAveraged)
+		{
+			mLength = size;
+			mMagnitude = magnitude;
+			mPhase = phase;
+			mCoherence = coherence;
+			mIndex = index;
+			mSampleRate = sampleRate;
+			mFramesAveraged = framesAveraged;
+		}
+
+		size_t mLength;
+		size_t mIndex;
+		size_t mSampleRate;
+		size_t mFramesAveraged;
+		const double* mMagnitude;	// |H(f)|, linear
+		const double* mPhase;		// arg H(f), radians in [-pi, pi]
+		const double* mCoherence;	// Magnitude-squared coherence, [0, 1]
+	};
+
+	// Dual-channel (reference/measurement) analyzer. Keeps running averages of auto and cross spectra
+	// and derives transfer function and coherence from them.
+	//
+	// Both channels are real, so instead of running two FFTs we pack reference into real part and
+	// measurement into imaginary part of a single complex frame - the very slot SpectroCalculator fills
+	// with zeroes - and separate the two spectra afterwards using conjugate symmetry:
+	// X[k] = (Z[k] + conj(Z[N - k])) / 2, Y[k] = (Z[k] - conj(Z[N - k])) / 2j
+	template <typename T> class TransferFunctionCalculator
+	{
+	public:
+		enum Estimator
+		{
+			estimatorH1 = 0,	// Gxy / Gxx, unbiased with noise on measurement channel
+			estimatorH2			// Gyy / Gyx, unbiased with noise on reference channel
+		};
+
+		TransferFunctionCalculator(double sampleRate, double averagingMs, size_t index, size_t fftSize = 1024) :
+			mBuffer(fftSize * 2, fftSize),
+			mWindow(WindowTableCache::get<T>(WindowFunctionFactory::windowHann, fftSize, true))
+		{
+			mFftSize = fftSize;
+			mBinCount = fftSize / 2;
+			mIndex = index;
+			mSampleRate = sampleRate;
+			mEstimator = estimatorH1;
+
+			mGxx.resize(mBinCount);
+			mGyy.resize(mBinCount);
+			mGxyRe.resize(mBinCount);
+			mGxyIm.resize(mBinCount);
+			mMagnitude.resize(mBinCount);
+			mPhase.resize(mBinCount);
+			mCoherence.resize(mBinCount);
+
+			reset();
+			setAveragingTime(averagingMs);
+		}
+
+		~TransferFunctionCalculator()
+		{
+		}
+
+		// Pass std::numeric_limits<double>::infinity() to get plain linear average over all frames since last reset()
+		void setAveragingTime(double averagingMs)
+		{
+			mAveragingMs = averagingMs;
+			mAveragingCoef = tomatl::dsp::EnvelopeWalker::calculateCoeff(averagingMs, mSampleRate / mFftSize / mBuffer.getOverlappingFactor());
+		}
+
+		bool checkSampleRate(double sampleRate)
+		{
+			if (sampleRate != mSampleRate)
+			{
+				mSampleRate = sampleRate;
+				setAveragingTime(mAveragingMs);
+				reset();
+
+				return true;
+			}
+
+			return false;
+		}
+
+		void setEstimator(Estimator estimator) { mEstimator = estimator; }
+
+		void reset()
+		{
+			std::fill(mGxx.begin(), mGxx.end(), 0.);
+			std::fill(mGyy.begin(), mGyy.end(), 0.);
+			std::fill(mGxyRe.begin(), mGxyRe.end(), 0.);
+			std::fill(mGxyIm.begin(), mGxyIm.end(), 0.);
+			std::fill(mMagnitude.begin(), mMagnitude.end(), 0.);
+			std::fill(mPhase.begin(), mPhase.end(), 0.);
+			std::fill(mCoherence.begin(), mCoherence.end(), 0.);
+			mFramesAveraged = 0;
+		}
+
+		TransferFunctionBlock process(const T& reference, const T& measurement)
+		{
+			TOMATL_RT_SCOPE();
+
+			mBuffer.putOne(reference);
+			auto frame = mBuffer.putOne(measurement);
+
+			if (calculateSpectraFromBufferIfReady(std::get<0>(frame)))
+			{
+				return TransferFunctionBlock(mBinCount, &mMagnitude[0], &mPhase[0], &mCoherence[0], mIndex, mSampleRate, mFramesAveraged);
+			}
+			else
+			{
+				return TransferFunctionBlock();
+			}
+		}
+
+		// Averaged spectra, same scaling as SpectroCalculator magnitudes squared. Cross spectrum is conj(X) * Y.
+		const double* getReferencePower() { return &mGxx[0]; }
+		const double* getMeasurementPower() { return &mGyy[0]; }
+		const double* getCrossSpectrumReal() { return &mGxyRe[0]; }
+		const double* getCrossSpectrumImag() { return &mGxyIm[0]; }
+
+		size_t getBinCount() { return mBinCount; }
+		size_t getFramesAveraged() { return mFramesAveraged; }
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(TransferFunctionCalculator);
+
+		bool calculateSpectraFromBufferIfReady(T* frame)
+		{
+			if (frame == NULL)
+			{
+				return false;
+			}
+
+			// Window is real, so it applies to both packed channels in the same way
+			mWindow->applyToComplex(frame);
+
+			FftCalculator<T>::calculateFast(frame, mFftSize);
+
+			// Cumulative mean for infinite averaging, exponential otherwise
+			double newWeight = (mAveragingMs == std::numeric_limits<double>::infinity()) ? 1. / (mFramesAveraged + 1.) : 1. - mAveragingCoef;
+			double oldWeight = 1. - newWeight;
+
+			// Same amplitude normalization as in SpectroCalculator, additional 1/2 comes from unpacking
+			const double norm = 1. / mFftSize;
+
+			for (size_t bin = 0; bin < mBinCount; ++bin)
+			{
+				const T* z = frame + bin * 2;
+				const T* zc = frame + ((mFftSize - bin) % mFftSize) * 2;
+
+				double xRe = (z[0] + zc[0]) * norm;
+				double xIm = (z[1] - zc[1]) * norm;
+				double yRe = (z[1] + zc[1]) * norm;
+				double yIm = (zc[0] - z[0]) * norm;
+
+				// conj(X) * Y
+				double crossRe = xRe * yRe + xIm * yIm;
+				double crossIm = xRe * yIm - xIm * yRe;
+
+				mGxx[bin] = oldWeight * mGxx[bin] + newWeight * (xRe * xRe + xIm * xIm);
+				mGyy[bin] = oldWeight * mGyy[bin] + newWeight * (yRe * yRe + yIm * yIm);
+				mGxyRe[bin] = oldWeight * mGxyRe[bin] + newWeight * crossRe;
+				mGxyIm[bin] = oldWeight * mGxyIm[bin] + newWeight * crossIm;
+
+				double crossPower = mGxyRe[bin] * mGxyRe[bin] + mGxyIm[bin] * mGxyIm[bin];
+				double autoProduct = mGxx[bin] * mGyy[bin];
+
+				mCoherence[bin] = autoProduct > 0. ? std::min(1., crossPower / autoProduct) : 0.;
+
+				// H1 = Gxy / Gxx and H2 = Gyy / Gyx share the phase of Gxy, only magnitude differs
+				if (mEstimator == estimatorH1)
+				{
+					mMagnitude[bin] = mGxx[bin] > 0. ? std::sqrt(crossPower) / mGxx[bin] : 0.;
+				}
+				else
+				{
+					mMagnitude[bin] = crossPower > 0. ? mGyy[bin] / std::sqrt(crossPower) : 0.;
+				}
+
+				mPhase[bin] = std::atan2(mGxyIm[bin], mGxyRe[bin]);
+			}
+
+			++mFramesAveraged;
+
+			return true;
+		}
+
+		OverlappingBufferSequence<T> mBuffer;
+		std::shared_ptr<const WindowTable<T>> mWindow;
+		std::vector<double> mGxx;
+		std::vector<double> mGyy;
+		std::vector<double> mGxyRe;
+		std::vector<double> mGxyIm;
+		std::vector<double> mMagnitude;
+		std::vector<double> mPhase;
+		std::vector<double> mCoherence;
+		Estimator mEstimator;
+		size_t mFftSize;
+		size_t mBinCount;
+		size_t mIndex;
+		size_t mFramesAveraged;
+		double mSampleRate;
+		double mAveragingMs;
+		double mAveragingCoef;
+	};
+
+}}
+
+#endif
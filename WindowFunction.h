@@ -2,6 +2,11 @@
 #define TOMATL_WINDOW_FUNCTION
 
 #include <functional>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
 
 namespace tomatl { namespace dsp{
 
@@ -79,6 +84,176 @@ public:
 	}
 };
 
+// Discrete prolate spheroidal sequences (Slepian tapers): of all sequences of given length, they have maximum energy concentration
+// within [-W, W] frequency band. They are eigenvectors of a symmetric tridiagonal matrix (Percival & Walden, 8.3),
+// eigenvalues are found with Sturm sequence bisection, vectors with inverse iteration. Not for RT thread, it's O(N * count) with big constant.
+template <typename T> class DpssCalculator
+{
+private:
+	DpssCalculator(){}
+public:
+	// timeBandwidth is NW, usual choice is 2.5...4 with count = 2 * NW - 1 tapers. Tapers are normalized to unit energy.
+	static std::vector<std::vector<T>> calculate(size_t length, double timeBandwidth, size_t count)
+	{
+		std::vector<double> diagonal(length);
+		std::vector<double> offDiagonal(length, 0.);
+		double w = timeBandwidth / length;
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			double a = (length - 1. - 2. * i) / 2.;
+
+			diagonal[i] = a * a * std::cos(2. * TOMATL_PI * w);
+
+			if (i > 0)
+			{
+				offDiagonal[i] = i * (length - (double)i) / 2.;
+			}
+		}
+
+		// Gershgorin bounds for all eigenvalues
+		double low = diagonal[0], high = diagonal[0];
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			double radius = offDiagonal[i] + (i + 1 < length ? offDiagonal[i + 1] : 0.);
+
+			low = std::min(low, diagonal[i] - radius);
+			high = std::max(high, diagonal[i] + radius);
+		}
+
+		std::vector<std::vector<T>> result;
+		std::vector<std::vector<double>> vectors;
+		count = std::min(count, length);
+
+		for (size_t k = 0; k < count; ++k)
+		{
+			// k-th largest eigenvalue has exactly (length - 1 - k) eigenvalues below it
+			size_t target = length - 1 - k;
+			double a = low, b = high;
+
+			for (int iteration = 0; iteration < 200 && (b - a) > 1e-14 * std::max(std::abs(a), std::abs(b)); ++iteration)
+			{
+				double middle = 0.5 * (a + b);
+
+				if (countEigenvaluesBelow(diagonal, offDiagonal, middle) > target)
+				{
+					b = middle;
+				}
+				else
+				{
+					a = middle;
+				}
+			}
+
+			vectors.push_back(inverseIteration(diagonal, offDiagonal, 0.5 * (a + b), vectors));
+
+			// Sign convention: symmetric tapers have positive sum, antisymmetric ones start with positive lobe
+			const std::vector<double>& v = vectors.back();
+			double sign = 0.;
+
+			for (size_t i = 0; i < length; ++i)
+			{
+				sign += (k % 2 == 0) ? v[i] : v[i] * ((length - 1.) / 2. - i);
+			}
+
+			result.push_back(std::vector<T>(length));
+
+			for (size_t i = 0; i < length; ++i)
+			{
+				result.back()[i] = (T)(sign < 0. ? -v[i] : v[i]);
+			}
+		}
+
+		return result;
+	}
+
+private:
+	static size_t countEigenvaluesBelow(const std::vector<double>& d, const std::vector<double>& e, double x)
+	{
+		size_t count = 0;
+		double q = 1.;
+
+		for (size_t i = 0; i < d.size(); ++i)
+		{
+			q = d[i] - x - (i > 0 ? e[i] * e[i] / q : 0.);
+
+			if (q == 0.)
+			{
+				q = 1e-300;
+			}
+
+			if (q < 0.)
+			{
+				++count;
+			}
+		}
+
+		return count;
+	}
+
+	static std::vector<double> inverseIteration(const std::vector<double>& d, const std::vector<double>& e, double eigenvalue, const std::vector<std::vector<double>>& previous)
+	{
+		const size_t n = d.size();
+		std::vector<double> x(n), c(n), y(n);
+
+		// Start vector which has nonzero projection onto both symmetric and antisymmetric vectors
+		for (size_t i = 0; i < n; ++i)
+		{
+			x[i] = 1. + (double)i / n;
+		}
+
+		// Shift slightly off the eigenvalue, so the system is solvable, yet very ill-conditioned in the right direction
+		double shifted = eigenvalue + 1e-10 * std::max(1., std::abs(eigenvalue));
+
+		for (int iteration = 0; iteration < 3; ++iteration)
+		{
+			// Thomas algorithm for (A - shifted * I) y = x
+			double pivot = d[0] - shifted;
+
+			for (size_t i = 0; i < n; ++i)
+			{
+				if (i > 0)
+				{
+					c[i - 1] = e[i] / pivot;
+					pivot = d[i] - shifted - e[i] * c[i - 1];
+				}
+
+				if (pivot == 0.)
+				{
+					pivot = 1e-300;
+				}
+
+				y[i] = (x[i] - (i > 0 ? e[i] * y[i - 1] : 0.)) / pivot;
+			}
+
+			for (size_t i = n - 1; i > 0; --i)
+			{
+				y[i - 1] -= c[i - 1] * y[i];
+			}
+
+			// Keep it orthogonal to already found vectors in case eigenvalues are close
+			for (size_t v = 0; v < previous.size(); ++v)
+			{
+				double projection = 0.;
+
+				for (size_t i = 0; i < n; ++i) projection += y[i] * previous[v][i];
+				for (size_t i = 0; i < n; ++i) y[i] -= projection * previous[v][i];
+			}
+
+			double norm = 0.;
+
+			for (size_t i = 0; i < n; ++i) norm += y[i] * y[i];
+
+			norm = 1. / std::sqrt(norm);
+
+			for (size_t i = 0; i < n; ++i) x[i] = y[i] * norm;
+		}
+
+		return x;
+	}
+};
+
 class WindowFunctionFactory
 {
 private:
@@ -90,10 +265,29 @@ public:
 		windowBlackmanHarris,
 		windowHann,
 		windowBarlett,
-		windowMystic
+		windowMystic,
+		windowKaiser,	// parameter is beta, 0 means default of 8.6 (~-90dB sidelobes)
+		windowFlatTop,	// Amplitude-accurate, scalloping loss is below 0.01dB
+		windowDpss		// First Slepian taper, parameter is time-bandwidth product NW, 0 means default of 4
 	};
 
-	template <typename T> static std::function<T(const int&, const size_t&)> getWindowCalculator(FunctionType type)
+	// Modified Bessel function of the first kind, zero order. Power series converges quickly for window arguments.
+	static double besselI0(double x)
+	{
+		double sum = 1.;
+		double term = 1.;
+		double halfX = x / 2.;
+
+		for (int k = 1; k < 200 && term > sum * 1e-17; ++k)
+		{
+			term *= (halfX / k) * (halfX / k);
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	template <typename T> static std::function<T(const int&, const size_t&)> getWindowCalculator(FunctionType type, double parameter = 0.)
 	{
 		if (type == windowRectangle)
 		{
@@ -137,11 +331,207 @@ public:
 				return std::sin(TOMATL_PI / 2 * a * a);
 			};
 		}
+		else if (type == windowKaiser)
+		{
+			double beta = parameter > 0. ? parameter : 8.6;
+			double norm = 1. / besselI0(beta);
+
+			return [beta, norm](const int& i, const size_t& length)
+			{
+				double a = 2. * i / ((double)length - 1.) - 1.;
+
+				return (T)(besselI0(beta * std::sqrt(std::max(0., 1. - a * a))) * norm);
+			};
+		}
+		else if (type == windowFlatTop) // Five-term flat top (same as in MATLAB)
+		{
+			return [](const int& i, const size_t& length)
+			{
+				T a0 = 0.21557895;
+				T a1 = 0.41663158;
+				T a2 = 0.277263158;
+				T a3 = 0.083578947;
+				T a4 = 0.006947368;
+
+				return
+					a0 -
+					a1 * std::cos(2 * TOMATL_PI * i / (length - 1)) +
+					a2 * std::cos(4 * TOMATL_PI * i / (length - 1)) -
+					a3 * std::cos(6 * TOMATL_PI * i / (length - 1)) +
+					a4 * std::cos(8 * TOMATL_PI * i / (length - 1));
+			};
+		}
+		else if (type == windowDpss)
+		{
+			double timeBandwidth = parameter > 0. ? parameter : 4.;
+
+			// Taper can't be evaluated sample by sample, so it is calculated as a whole on first call (and on length change)
+			// and shared between copies of this function object
+			std::shared_ptr<std::vector<T>> taper = std::make_shared<std::vector<T>>();
+
+			return [timeBandwidth, taper](const int& i, const size_t& length)
+			{
+				if (taper->size() != length)
+				{
+					*taper = DpssCalculator<T>::calculate(length, timeBandwidth, 1)[0];
+				}
+
+				return (*taper)[i];
+			};
+		}
 		else
 		{
 			throw 20; // TODO: exception
 		}
 	}
+
+	// Periodic cosine-sum windows of sizes which have compile-time tables are read from them instead of calling
+	// the per-sample function. Returns false if there are no tables for this case, destination is untouched then.
+	template <typename T> static bool calculateFromFixedTables(FunctionType type, size_t length, bool periodicMode, T* destination)
+	{
+		const FixedSizeTables::TableSet* tables = periodicMode ? FixedSizeTables::get(length) : NULL;
+
+		if (tables == NULL)
+		{
+			return false;
+		}
+
+		// w[i] = a0 - a1 * cos(x) + a2 * cos(2x) - a3 * cos(3x) + a4 * cos(4x), x = 2 * pi * i / length
+		double a[5] = { 0., 0., 0., 0., 0. };
+
+		if (type == windowRectangle)
+		{
+			a[0] = 1.;
+		}
+		else if (type == windowHann)
+		{
+			a[0] = 0.5; a[1] = 0.5;
+		}
+		else if (type == windowBlackmanHarris)
+		{
+			a[0] = 0.35875; a[1] = 0.48829; a[2] = 0.14128; a[3] = 0.01168;
+		}
+		else if (type == windowFlatTop)
+		{
+			a[0] = 0.21557895; a[1] = 0.41663158; a[2] = 0.277263158; a[3] = 0.083578947; a[4] = 0.006947368;
+		}
+		else
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			destination[i] = (T)(a[0] - a[1] * tables->cos2Pi(i) + a[2] * tables->cos2Pi(i * 2) - a[3] * tables->cos2Pi(i * 3) + a[4] * tables->cos2Pi(i * 4));
+		}
+
+		return true;
+	}
+};
+
+// Immutable precalculated window with normalization (see WindowFunction::getNormalizationFactor) already folded in,
+// so windowing and scaling is one multiply per sample. Obtain instances through WindowTableCache.
+template <typename T> class WindowTable
+{
+private:
+	std::vector<T> mTable;
+	std::vector<T> mInterleaved;
+	T mNormalizationFactor;
+
+	TOMATL_DECLARE_NON_MOVABLE_COPYABLE(WindowTable);
+public:
+	WindowTable(WindowFunctionFactory::FunctionType type, size_t length, bool periodicMode, double parameter = 0.)
+	{
+		mTable.assign(length, 1.);
+
+		if (WindowFunctionFactory::calculateFromFixedTables<T>(type, length, periodicMode, &mTable[0]))
+		{
+			// Same normalization as WindowFunction does (it divides by length + 1 in periodic mode)
+			T sum = 0.;
+
+			for (size_t i = 0; i < length; ++i) sum += mTable[i];
+
+			mNormalizationFactor = sum / (length + 1);
+
+			for (size_t i = 0; i < length; ++i) mTable[i] /= mNormalizationFactor;
+		}
+		else
+		{
+			WindowFunction<T> source(length, WindowFunctionFactory::getWindowCalculator<T>(type, parameter), periodicMode);
+
+			// Windowing a signal of all ones gives us the scaled window itself
+			source.applyFunction(&mTable[0], 0, length, true);
+			mNormalizationFactor = source.getNormalizationFactor();
+		}
+
+		// Duplicated values, so interleaved complex frames {re, im, re, im, ...} are windowed with one contiguous multiply
+		mInterleaved.resize(length * 2);
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			mInterleaved[i * 2] = mInterleaved[i * 2 + 1] = mTable[i];
+		}
+	}
+
+	// signal[0...length-1]
+	forcedinline void apply(T* signal) const
+	{
+		const T* table = &mTable[0];
+		const size_t length = mTable.size();
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			signal[i] *= table[i];
+		}
+	}
+
+	// Interleaved complex signal[0...2*length-1], both parts are multiplied
+	forcedinline void applyToComplex(T* signal) const
+	{
+		const T* table = &mInterleaved[0];
+		const size_t length = mInterleaved.size();
+
+		for (size_t i = 0; i < length; ++i)
+		{
+			signal[i] *= table[i];
+		}
+	}
+
+	forcedinline size_t getLength() const { return mTable.size(); }
+	forcedinline const T* getData() const { return &mTable[0]; }
+
+	// Already applied, for those who need to undo it
+	forcedinline const T& getNormalizationFactor() const { return mNormalizationFactor; }
+};
+
+// Process-wide cache of window tables keyed by (type, length, periodic mode, window parameter). Each precision T has its own map,
+// so precision is part of the key too. Tables are shared between all analyzers using the same window and get
+// released when the last user goes away. Lookup locks a mutex, so it's for construction/reconfiguration, not for RT path.
+class WindowTableCache
+{
+private:
+	WindowTableCache(){}
+public:
+	template <typename T> static std::shared_ptr<const WindowTable<T>> get(WindowFunctionFactory::FunctionType type, size_t length, bool periodicMode, double parameter = 0.)
+	{
+		typedef std::tuple<int, size_t, bool, double> Key;
+
+		static std::mutex lock;
+		static std::map<Key, std::weak_ptr<const WindowTable<T>>> tables;
+
+		std::lock_guard<std::mutex> guard(lock);
+
+		Key key((int)type, length, periodicMode, parameter);
+		std::shared_ptr<const WindowTable<T>> result = tables[key].lock();
+
+		if (!result)
+		{
+			result = std::make_shared<const WindowTable<T>>(type, length, periodicMode, parameter);
+			tables[key] = result;
+		}
+
+		return result;
+	}
 };
 
 }}
@@ -0,0 +1,302 @@
+#ifndef TOMATL_ZOOM_FFT_CALCULATOR
+#define TOMATL_ZOOM_FFT_CALCULATOR
+
+#include <vector>
+#include <cmath>
+#include <limits>
+
+namespace tomatl { namespace dsp {
+
+	// Zoom FFT: high resolution spectrum of a narrow band around arbitrary center frequency. The band is shifted to DC
+	// by a complex oscillator, real and imaginary parts are decimated by zoomFactor (Decimator, so it is rounded down
+	// to a power of two) and a small complex FFT of the result shows the band with resolution of
+	// sampleRate / zoomFactor / fftSize. E.g. 1024 points with zoom 64 at 48 kHz resolve 0.73 Hz over 600 Hz band,
+	// which would otherwise take a 65536 point FFT.
+	//
+	// Only the part of the band which decimators keep free of aliasing is output: 80% of decimated rate, where anything
+	// folding in is at least 90 dB down with cDecimatorTaps long stages. Blocks carry frequency of the first bin and
+	// bin width, so FrequencyDomainGrid maps them to absolute frequencies by itself.
+	// Frames overlap by half, magnitudes are scaled and smoothed the same way SpectroCalculator does it.
+	//
+	// Input is real, so mixing also brings its negative frequency image, which lands at -(f + center). It would fold
+	// into the band for centers closer than half the bandwidth to DC (and likewise to Nyquist), so center frequency
+	// is kept within [bandwidth / 2, sampleRate / 2 - bandwidth / 2]. Zoom factor has to be at least 2 for this range
+	// to exist.
+	template <typename T> class ZoomFftCalculator
+	{
+	public:
+		ZoomFftCalculator(double sampleRate, double centerFrequency, size_t zoomFactor, size_t fftSize = 1024,
+			std::pair<double, double> attackRelease = std::pair<double, double>(0., 0.), size_t index = 0)
+			: mDecimatorRe(zoomFactor, cDecimatorTaps), mDecimatorIm(zoomFactor, cDecimatorTaps),
+			mWindow(WindowTableCache::get<T>(WindowFunctionFactory::windowHann, fftSize, true))
+		{
+			mFftSize = fftSize;
+			mHopSize = fftSize / 2;
+			mIndex = index;
+			mSampleRate = 0.;
+			mRequestedCenterFrequency = centerFrequency;
+			mCenterFrequency = centerFrequency;
+			mAttackMs = attackRelease.first;
+			mReleaseMs = attackRelease.second;
+			mPhasor = std::pair<double, double>(1., 0.);
+
+			// Clean part of the band, even number of bins centered on DC
+			mFirstBin = (size_t)(mFftSize * 0.1);
+			mOutputLength = mFftSize - 2 * mFirstBin;
+
+			mHistory.assign(mFftSize * 4, 0.);
+			mFrame.assign(mFftSize * 2, 0.);
+			mMixed.assign(cChunkLength * 2, 0.);
+			mDecimated.assign((cChunkLength / mDecimatorRe.getFactor() + 1) * 2, 0.);
+			mOutput.assign(mOutputLength, std::pair<double, double>(0., 0.));
+
+			for (size_t i = 0; i < mOutputLength; ++i)
+			{
+				mOutput[i].first = i;
+			}
+
+			reset();
+			checkSampleRate(sampleRate);
+		}
+
+		// Band moves immediately, smoothed spectrum is cleared and the next frame waits for a full window of new data.
+		// Centers too close to DC or Nyquist are moved inward, getCenterFrequency() returns the one in use.
+		void setCenterFrequency(double frequency)
+		{
+			mRequestedCenterFrequency = frequency;
+
+			if (clampCenterFrequency(frequency) != mCenterFrequency)
+			{
+				updateOscillator();
+				reset();
+			}
+		}
+
+		void setAttackSpeed(double speed)
+		{
+			mAttackMs = speed;
+			mAttackRelease.first = EnvelopeWalker::calculateCoeff(speed, getFrameRate());
+		}
+
+		void setReleaseSpeed(double speed)
+		{
+			mReleaseMs = speed;
+			mAttackRelease.second = EnvelopeWalker::calculateCoeff(speed, getFrameRate());
+		}
+
+		double getCenterFrequency() { return mCenterFrequency; }
+		size_t getZoomFactor() { return mDecimatorRe.getFactor(); }
+		size_t getFftSize() { return mFftSize; }
+
+		double getOutputSampleRate() { return mDecimatorRe.getOutputSampleRate(mSampleRate); }
+		double getBinWidth() { return getOutputSampleRate() / mFftSize; }
+
+		// Width of the band actually output, Hz
+		double getBandwidth() { return mOutputLength * getBinWidth(); }
+
+		void reset()
+		{
+			std::fill(mHistory.begin(), mHistory.end(), 0.);
+
+			for (size_t i = 0; i < mOutputLength; ++i)
+			{
+				mOutput[i].second = 0.;
+			}
+
+			mWritePosition = 0;
+			mSamplesSinceHop = 0;
+			mSamplesSeen = 0;
+		}
+
+		// Mono input in arbitrary blocks. Returns the latest frame completed during this block,
+		// or block with NULL data if there was none. Data stays valid until the next call.
+		SpectrumBlock process(const T* input, size_t count, double sampleRate)
+		{
+			TOMATL_RT_SCOPE();
+
+			checkSampleRate(sampleRate);
+
+			bool ready = false;
+
+			for (size_t start = 0; start < count; start += cChunkLength)
+			{
+				size_t length = std::min(cChunkLength, count - start);
+
+				mix(input + start, length);
+
+				size_t produced = mDecimatorRe.process(&mMixed[0], length, &mDecimated[0]);
+				mDecimatorIm.process(&mMixed[cChunkLength], length, &mDecimated[mDecimated.size() / 2]);
+
+				ready = pushDecimated(produced) || ready;
+			}
+
+			if (!ready)
+			{
+				return SpectrumBlock();
+			}
+
+			double binWidth = getBinWidth();
+			double firstBinFrequency = mCenterFrequency - (mOutputLength / 2) * binWidth;
+
+			return SpectrumBlock(mOutputLength, &mOutput[0], mIndex, getOutputSampleRate(), firstBinFrequency, binWidth);
+		}
+
+	private:
+		TOMATL_DECLARE_NON_MOVABLE_COPYABLE(ZoomFftCalculator);
+
+		// Input samples mixed and decimated at once
+		static constexpr size_t cChunkLength = 512;
+
+		// Half-band stage length, keeps aliases 90 dB down over the output band (see Decimator)
+		static const size_t cDecimatorTaps = 63;
+
+		double getFrameRate() { return getOutputSampleRate() / mHopSize; }
+
+		void checkSampleRate(double sampleRate)
+		{
+			if (sampleRate != mSampleRate)
+			{
+				mSampleRate = sampleRate;
+				updateOscillator();
+				setAttackSpeed(mAttackMs);
+				setReleaseSpeed(mReleaseMs);
+			}
+		}
+
+		double clampCenterFrequency(double frequency)
+		{
+			const double margin = getBandwidth() * 0.5;
+
+			return std::max(margin, std::min(mSampleRate * 0.5 - margin, frequency));
+		}
+
+		void updateOscillator()
+		{
+			mCenterFrequency = clampCenterFrequency(mRequestedCenterFrequency);
+
+			double omega = 2. * TOMATL_PI * mCenterFrequency / mSampleRate;
+
+			// exp(-j * omega): band center goes to DC
+			mStep = std::pair<double, double>(std::cos(omega), -std::sin(omega));
+		}
+
+		// Real parts go to the first half of mMixed, imaginary ones to the second, as decimators want them
+		void mix(const T* input, size_t length)
+		{
+			double re = mPhasor.first;
+			double im = mPhasor.second;
+			const double stepRe = mStep.first;
+			const double stepIm = mStep.second;
+
+			for (size_t i = 0; i < length; ++i)
+			{
+				mMixed[i] = (T)(input[i] * re);
+				mMixed[cChunkLength + i] = (T)(input[i] * im);
+
+				double nextRe = re * stepRe - im * stepIm;
+				im = re * stepIm + im * stepRe;
+				re = nextRe;
+			}
+
+			// Recursive rotation slowly drifts off the unit circle, one Newton step per chunk pulls it back
+			double correction = (3. - (re * re + im * im)) * 0.5;
+			mPhasor = std::pair<double, double>(re * correction, im * correction);
+		}
+
+		bool pushDecimated(size_t count)
+		{
+			const T* re = &mDecimated[0];
+			const T* im = &mDecimated[mDecimated.size() / 2];
+			bool ready = false;
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				// Written twice, so the latest window is always contiguous
+				mHistory[mWritePosition * 2] = mHistory[(mWritePosition + mFftSize) * 2] = re[i];
+				mHistory[mWritePosition * 2 + 1] = mHistory[(mWritePosition + mFftSize) * 2 + 1] = im[i];
+				mWritePosition = (mWritePosition + 1) % mFftSize;
+
+				++mSamplesSinceHop;
+				++mSamplesSeen;
+
+				if (mSamplesSinceHop >= mHopSize && mSamplesSeen >= mFftSize)
+				{
+					mSamplesSinceHop = 0;
+					calculateFrame();
+					ready = true;
+				}
+			}
+
+			return ready;
+		}
+
+		void calculateFrame()
+		{
+			// Oldest sample first
+			std::copy(mHistory.begin() + mWritePosition * 2, mHistory.begin() + (mWritePosition + mFftSize) * 2, mFrame.begin());
+
+			mWindow->applyToComplex(&mFrame[0]);
+			FftCalculator<T>::calculateFast(&mFrame[0], mFftSize);
+
+			// Complex input: negative frequencies are in the upper half. Output bin 0 is the lowest kept one,
+			// i.e. FFT bin N / 2 + mFirstBin. Same 2 / N scale as SpectroCalculator, so a real sine inside the band,
+			// which becomes a single complex exponential of half its amplitude after mixing, reads its full amplitude.
+			const double norm = 2. / mFftSize;
+			const size_t half = mFftSize / 2;
+
+			for (size_t bin = 0; bin < mOutputLength; ++bin)
+			{
+				size_t source = (bin + mFirstBin + half) % mFftSize;
+				double re = mFrame[source * 2];
+				double im = mFrame[source * 2 + 1];
+
+				smoothBin(mOutput[bin].second, std::sqrt(re * re + im * im) * norm);
+			}
+
+			++mIndex;
+		}
+
+		forcedinline void smoothBin(double& target, double ampl)
+		{
+			// Special case - hold spectrum (aka infinite release time)
+			if (mAttackRelease.second == std::numeric_limits<double>::infinity())
+			{
+				target = std::max(target, ampl);
+			}
+			else
+			{
+				EnvelopeWalker::staticProcess(ampl, &target, mAttackRelease.first, mAttackRelease.second);
+			}
+		}
+
+		size_t mFftSize;
+		size_t mHopSize;
+		size_t mIndex;
+		size_t mFirstBin;
+		size_t mOutputLength;
+		double mSampleRate;
+		double mRequestedCenterFrequency;
+		double mCenterFrequency;
+		double mAttackMs;
+		double mReleaseMs;
+		std::pair<double, double> mAttackRelease;
+		std::pair<double, double> mPhasor;
+		std::pair<double, double> mStep;
+		size_t mWritePosition;
+		size_t mSamplesSinceHop;
+		size_t mSamplesSeen;
+		Decimator<T> mDecimatorRe;
+		Decimator<T> mDecimatorIm;
+		std::shared_ptr<const WindowTable<T>> mWindow;
+		std::vector<T> mHistory;
+		std::vector<T> mFrame;
+		std::vector<T> mMixed;
+		std::vector<T> mDecimated;
+		std::vector<std::pair<double, double>> mOutput;
+	};
+
+	template <typename T> constexpr size_t ZoomFftCalculator<T>::cChunkLength;
+
+}}
+
+#endif
@@ -56,16 +56,34 @@
 	#define forcedinline __forceinline
 #endif
 
+#include "RtSafety.h"
 #include "spsc_queue.h"
+#include "ParameterExchange.h"
+#include "Profiler.h"
 #include "Buffer.h"
 #include "Coord.h"
+#include "FixedSizeTables.h"
 #include "Scaling.h"
 #include "WindowFunction.h"
 #include "EnvelopeWalker.h"
+#include "StereoMeter.h"
 #include "GonioCalculator.h"
+#include "GonioRasterizer.h"
 #include "FftCalculator.h"
+#include "MultitaperEstimator.h"
 #include "SpectroCalculator.h"
-//#include "BiQuad.h"
+#include "AsyncSpectroCalculator.h"
+#include "AnalysisScheduler.h"
+#include "TransferFunctionCalculator.h"
+#include "OfflineSpectroAnalyzer.h"
+#include "BiQuad.h"
+#include "LoudnessMeter.h"
+#include "MeterBank.h"
+#include "Decimator.h"
+#include "ZoomFftCalculator.h"
+#include "SparseBinTracker.h"
 #include "FrequencyDomainGrid.h"
+#include "SpectralPeakDetector.h"
+#include "PitchDetector.h"
 
 #endif
@@ -2,6 +2,10 @@
 #define TOMATL_SPSC_QUEUE
 //#include <Windows.h>
 
+#include <atomic>
+#include <vector>
+#include <cstring>
+
 // TODO: memory fences
 namespace tomatl { namespace dsp {
 
@@ -51,8 +55,10 @@ public:
       while (n);
   }
 
+  // may allocate when node cache is exhausted, which is reported in rt safety checking mode
   void enqueue(T v)
   {
+      TOMATL_RT_SCOPE();
       node* n = alloc_node();
       n->next_ = 0;
       n->value_ = v;
@@ -123,6 +129,149 @@ private:
   spsc_queue& operator = (spsc_queue const&);
 };
 
+// bounded single-producer/single-consumer ring of trivially copyable values.
+// unlike spsc_queue it never allocates after construction, so it's safe to write from realtime thread.
+// write() and read() move as many values as fit/are available with at most two memcpy's each.
+template<typename T>
+class spsc_ring
+{
+public:
+  // capacity is rounded up to power of two
+  explicit spsc_ring(size_t capacity)
+    : read_(0), write_(0)
+  {
+      size_t size = 1;
+      while (size < capacity) size <<= 1;
+      buffer_.resize(size);
+      mask_ = size - 1;
+  }
+
+  size_t capacity() const { return buffer_.size(); }
+
+  // producer side, returns number of values actually written
+  size_t write(const T* data, size_t count)
+  {
+      size_t w = write_.load(std::memory_order_relaxed);
+      size_t r = read_.load(std::memory_order_acquire);
+      size_t free = buffer_.size() - (w - r);
+      count = count < free ? count : free;
+
+      copy_in(w & mask_, data, count);
+      write_.store(w + count, std::memory_order_release);
+
+      return count;
+  }
+
+  // exact on producer side
+  size_t free_space() const
+  {
+      return buffer_.size() - (write_.load(std::memory_order_relaxed) - read_.load(std::memory_order_acquire));
+  }
+
+  // consumer side, returns number of values actually read
+  size_t read(T* data, size_t count)
+  {
+      size_t r = read_.load(std::memory_order_relaxed);
+      size_t w = write_.load(std::memory_order_acquire);
+      size_t used = w - r;
+      count = count < used ? count : used;
+
+      copy_out(r & mask_, data, count);
+      read_.store(r + count, std::memory_order_release);
+
+      return count;
+  }
+
+  // approximate if called from a thread other than producer or consumer
+  size_t size() const
+  {
+      return write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire);
+  }
+
+private:
+  void copy_in(size_t pos, const T* data, size_t count)
+  {
+      size_t first = buffer_.size() - pos;
+      first = count < first ? count : first;
+      memcpy(&buffer_[pos], data, first * sizeof(T));
+      memcpy(&buffer_[0], data + first, (count - first) * sizeof(T));
+  }
+
+  void copy_out(size_t pos, T* data, size_t count)
+  {
+      size_t first = buffer_.size() - pos;
+      first = count < first ? count : first;
+      memcpy(data, &buffer_[pos], first * sizeof(T));
+      memcpy(data + first, &buffer_[0], (count - first) * sizeof(T));
+  }
+
+  std::vector<T> buffer_;
+  size_t mask_;
+
+  // indices grow monotonically and are masked on access, so full and empty states are distinguishable
+  std::atomic<size_t> read_;
+  char cache_line_pad_ [cache_line_size];
+  std::atomic<size_t> write_;
+
+  spsc_ring(spsc_ring const&);
+  spsc_ring& operator = (spsc_ring const&);
+};
+
+// single-writer/single-reader latest-value exchange.
+// writer fills back() and calls publish(), reader calls update() and reads front().
+// neither side ever waits or allocates, reader always sees the most recent complete value, intermediate ones may be skipped.
+template<typename T>
+class triple_buffer
+{
+public:
+  triple_buffer()
+    : ready_(1), back_(2), front_(0)
+  {
+  }
+
+  explicit triple_buffer(const T& initial)
+    : ready_(1), back_(2), front_(0)
+  {
+      for (int i = 0; i < 3; ++i) buffers_[i] = initial;
+  }
+
+  // writer side
+  T& back() { return buffers_[back_]; }
+
+  void publish()
+  {
+      back_ = ready_.exchange(back_ | fresh_flag, std::memory_order_acq_rel) & index_mask;
+  }
+
+  // reader side, returns true if front() has changed
+  bool update()
+  {
+      if ((ready_.load(std::memory_order_relaxed) & fresh_flag) == 0)
+      {
+          return false;
+      }
+
+      front_ = ready_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+      return true;
+  }
+
+  T& front() { return buffers_[front_]; }
+
+private:
+  static const int fresh_flag = 4;
+  static const int index_mask = 3;
+
+  T buffers_[3];
+  // index of buffer waiting for reader, plus flag telling whether it was published after reader's last update
+  std::atomic<int> ready_;
+  char cache_line_pad_ [cache_line_size];
+  int back_;
+  int front_;
+
+  triple_buffer(triple_buffer const&);
+  triple_buffer& operator = (triple_buffer const&);
+};
+
 // usage example
 /*int main()
 {